@@ -1,221 +1,494 @@
-#include "templates.cpp"
+#include "aho_corasick.h"
+#include "corpus.h"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <queue>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-struct Bor {
-private:
-    struct Node {
-        int terminal;
-        Node* suffix_link;
-        Node* compressed_suffix_link;
-        std::vector<Node*> children;
-
-        explicit Node(int terminal = 0) : terminal(terminal), suffix_link(nullptr), compressed_suffix_link(nullptr) {
-            children.resize(26, nullptr);
-        }
-
-        Node*& at(char c) {
-            return children[c - 'a'];
-        }
-
-        static char GetLetter(int i) {
-            return 'a' + i;
-        }
-    };
-
-    Node* root;
-    int n_patterns;
-    std::vector<size_t> pattern_sizes;
-
-    void MakeSuffixLinks() {
-        root->suffix_link = root;
-        std::queue<Node*> bfs;
-        for (Node* node : root->children) {
-            if (node == nullptr) {
-                continue;
-            }
-            node->suffix_link = root;
-            bfs.push(node);
-        }
-        while (!bfs.empty()) {
-            Node* node = bfs.front();
-            bfs.pop();
-            for (size_t i = 0; i < node->children.size(); ++i) {
-                if (node->children[i] == nullptr) {
-                    continue;
-                }
-                Node* parent_node = node->suffix_link;
-                while (parent_node != root && parent_node->children[i] == nullptr) {
-                    parent_node = parent_node->suffix_link;
-                }
-                if (parent_node->children[i] == nullptr) {
-                    node->children[i]->suffix_link = root;
-                } else {
-                    node->children[i]->suffix_link = parent_node->children[i];
-                }
-                bfs.push(node->children[i]);
-            }
+// время построения бора и память на вершину
+void BenchmarkConstruction() {
+    std::mt19937 gen(7);
+    for (int n_words : {10000, 100000}) {
+        std::vector<std::string> words;
+        std::uniform_int_distribution<size_t> length(4, 12);
+        for (int i = 0; i < n_words; ++i) {
+            words.push_back(RandomString(gen, length(gen), 26));
         }
+        Bor* bor = nullptr;
+        double build_time = MeasureSeconds([&] { bor = new Bor(words); });
+        size_t node_count = bor->NodeCount();
+        size_t node_bytes = bor->NodeBytes();
+        double free_time = MeasureSeconds([&] { delete bor; });
+        std::cout << n_words << " words, " << node_count << " nodes:\tbuild " << build_time * 1000 << " ms\tfree "
+                  << free_time * 1000 << " ms\t" << static_cast<double>(node_bytes) / node_count << " bytes/node\n";
     }
+}
 
-    void CompressSuffixLinks() {
-        std::queue<Node*> bfs;
-        bfs.push(root);
-        while (!bfs.empty()) {
-            Node* node = bfs.front();
-            bfs.pop();
-            if (node->suffix_link->terminal) {
-                node->compressed_suffix_link = node->suffix_link;
-            } else if (node->suffix_link->compressed_suffix_link != nullptr) {
-                node->compressed_suffix_link = node->suffix_link->compressed_suffix_link;
+// пропускная способность поиска до и после Compile() на тексте в несколько мегабайт
+void BenchmarkScan() {
+    const size_t text_size = 16 << 20;
+    std::mt19937 gen(2023);
+    for (int alphabet_size : {26, 4}) {
+        std::string text = RandomString(gen, text_size, alphabet_size);
+        for (int n_words : {100, 10000}) {
+            std::vector<std::string> words;
+            std::uniform_int_distribution<size_t> length(4, 12);
+            std::uniform_int_distribution<size_t> position(0, text_size - 12);
+            for (int i = 0; i < n_words; ++i) {
+                words.push_back(text.substr(position(gen), length(gen)));
             }
-            for (Node* next_node : node->children) {
-                if (next_node != nullptr) {
-                    bfs.push(next_node);
+            Bor bor(words);
+            std::cout << "alphabet " << alphabet_size << ", " << n_words << " words, " << (text_size >> 20) << " MB\n";
+            for (int compiled = 0; compiled < 2; ++compiled) {
+                if (compiled) {
+                    std::cout << "compile:\t" << MeasureSeconds([&] { bor.Compile(); }) * 1000 << " ms\n";
                 }
+                size_t found = 0;
+                double count_time = MeasureSeconds([&] { found += bor.CountOnString(text).size(); });
+                double find_time = MeasureSeconds([&] { found += bor.FindOnString(text).size(); });
+                std::cout << (compiled ? "compiled" : "trie") << "\tCountOnString " << (text_size >> 20) / count_time
+                          << " MB/s\tFindOnString " << (text_size >> 20) / find_time << " MB/s\n";
             }
         }
     }
+}
 
-    void FreeNodes(Node* node) {
-        if (node == nullptr) {
-            return;
-        }
-        for (Node* next_node : node->children) {
-            FreeNodes(next_node);
+// время до первого ответа: построение и компиляция автомата против отображения сохраненного файла
+void BenchmarkStartup() {
+    std::mt19937 gen(7);
+    std::string path = (std::filesystem::temp_directory_path() / "aho_corasick_bench.idx").string();
+    std::string text = RandomString(gen, 1 << 10, 26);
+    for (int n_words : {10000, 100000}) {
+        std::vector<std::string> words;
+        std::uniform_int_distribution<size_t> length(4, 12);
+        for (int i = 0; i < n_words; ++i) {
+            words.push_back(RandomString(gen, length(gen), 26));
         }
-        delete node;
+        size_t found = 0;
+        double build_time = MeasureSeconds([&] {
+            Bor bor(words);
+            bor.Compile();
+            found += bor.CountOnString(text)[0];
+        });
+        Bor(words).Save(path);
+        double load_time = MeasureSeconds([&] {
+            Bor bor = Bor::Load(path);
+            found -= bor.CountOnString(text)[0];
+        });
+        assert(found == 0);
+        std::cout << n_words << " words:\tbuild + compile + query " << build_time * 1000 << " ms\tload + query "
+                  << load_time * 1000 << " ms\tfile " << (std::filesystem::file_size(path) >> 10) << " KB\n";
     }
+    std::filesystem::remove(path);
+}
 
-public:
-    explicit Bor(const std::vector<std::string>& words) {
-        root = new Node();
-        n_patterns = words.size();
-        pattern_sizes.resize(n_patterns);
-        for (size_t j = 0; j < words.size(); ++j) {
-            const std::string& word = words[j];
-            pattern_sizes[j] = word.size();
-            Node* current = root;
-            for (size_t i = 0; i < word.size() - 1; ++i) {
-                char c = word[i];
-                if (current->at(c) == nullptr) {
-                    current->at(c) = new Node();
-                }
-                current = current->at(c);
-            }
-            char c = word.back();
-            if (current->at(c) == nullptr) {
-                current->at(c) = new Node(j);
-            } else {
-                current->at(c)->terminal = j;
+// масштабирование FindOnStringParallel по числу потоков, от 1 до числа ядер
+void BenchmarkParallelScan() {
+    const size_t text_size = 256 << 20;
+    std::mt19937 gen(2023);
+    std::string text = RandomString(gen, text_size, 26);
+    std::vector<std::string> words;
+    std::uniform_int_distribution<size_t> length(4, 12);
+    std::uniform_int_distribution<size_t> position(0, text_size - 12);
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back(text.substr(position(gen), length(gen)));
+    }
+    Bor bor(words);
+    bor.Compile();
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "alphabet 26, " << words.size() << " words, " << (text_size >> 20) << " MB, " << max_threads
+              << " hardware threads\n";
+    std::vector<int> thread_counts;
+    for (int n_threads = 1; n_threads < max_threads; n_threads *= 2) {
+        thread_counts.push_back(n_threads);
+    }
+    thread_counts.push_back(max_threads);
+    double single_time = 0;
+    for (int n_threads : thread_counts) {
+        size_t found = 0;
+        double time = MeasureSeconds([&] {
+            for (const std::vector<int>& positions : bor.FindOnStringParallel(text, n_threads)) {
+                found += positions.size();
             }
+        });
+        if (n_threads == 1) {
+            single_time = time;
         }
-
-        MakeSuffixLinks();
-        CompressSuffixLinks();
+        std::cout << n_threads << " threads:\t" << (text_size >> 20) / time << " MB/s\tspeedup " << single_time / time
+                  << "\t(" << found << " occurrences)\n";
     }
+}
 
-    [[nodiscard]] std::vector<int> CountOnString(const std::string& str) const {
-        Node* current = root;
-        std::vector<int> ans;
-        ans.resize(n_patterns);
-        for (char c : str) {
-            while (current != root && current->at(c) == nullptr) {
-                current = current->suffix_link;
-            }
-            if (current->at(c) == nullptr) {
-                continue;
-            }
-            current = current->at(c);
-            Node* terminal_node = current;
-            while (terminal_node != nullptr &&
-                   (terminal_node->terminal || terminal_node->compressed_suffix_link != nullptr)) {
-                ++ans[terminal_node->terminal];
-                terminal_node = terminal_node->compressed_suffix_link;
-            }
+// поиск по файлу: чтение целиком + FindOnString против Matcher с буфером фиксированного размера;
+// каждый вариант работает в отдельном процессе, чтобы ru_maxrss не зависел от остальных
+void BenchmarkStream() {
+    const size_t text_size = 256 << 20;
+    const size_t buffer_size = 1 << 16;
+    std::mt19937 gen(2023);
+    std::string path = (std::filesystem::temp_directory_path() / "aho_corasick_stream.txt").string();
+    std::vector<std::string> words;
+    {
+        std::string text = RandomString(gen, text_size, 26);
+        std::uniform_int_distribution<size_t> length(4, 12);
+        std::uniform_int_distribution<size_t> position(0, text_size - 12);
+        for (int i = 0; i < 1000; ++i) {
+            words.push_back(text.substr(position(gen), length(gen)));
         }
-        return ans;
+        std::ofstream(path, std::ios::binary).write(text.data(), text.size());
     }
+    Bor bor(words);
+    bor.Compile();
+    auto run = [&](const std::string& name, auto&& scan) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            long rss_before = usage.ru_maxrss;
+            size_t found = 0;
+            double time = MeasureSeconds([&] { found = scan(); });
+            getrusage(RUSAGE_SELF, &usage);
+            std::cout << name << ":\t" << (text_size >> 20) / time << " MB/s\tpeak RSS +"
+                      << (usage.ru_maxrss - rss_before) / 1024 << " MB\t(" << found << " occurrences)\n";
+            std::cout.flush();
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    };
+    run("whole file", [&] {
+        std::ifstream in(path, std::ios::binary);
+        std::string text(text_size, '\0');
+        in.read(text.data(), text.size());
+        size_t found = 0;
+        for (const std::vector<int>& positions : bor.FindOnString(text)) {
+            found += positions.size();
+        }
+        return found;
+    });
+    run("stream    ", [&] {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> buffer(buffer_size);
+        Bor::Matcher matcher(bor);
+        size_t found = 0;
+        while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+            matcher.Feed(std::string_view(buffer.data(), in.gcount()), [&](int, size_t) { ++found; });
+        }
+        return found;
+    });
+    std::filesystem::remove(path);
+}
 
-    [[nodiscard]] std::vector<std::vector<int>> FindOnString(const std::string& str) const {
-        Node* current = root;
-        std::vector<std::vector<int>> ans;
-        ans.resize(n_patterns);
-        for (size_t i = 0; i < str.size(); ++i) {
-            char c = str[i];
-            while (current != root && current->at(c) == nullptr) {
-                current = current->suffix_link;
-            }
-            if (current->at(c) == nullptr) {
-                continue;
-            }
-            current = current->at(c);
-            Node* terminal_node = current;
-            while (terminal_node != nullptr &&
-                   (terminal_node->terminal || terminal_node->compressed_suffix_link != nullptr)) {
-                size_t index = i + 1 - pattern_sizes[terminal_node->terminal];
-                ans[terminal_node->terminal].push_back(index);
-                terminal_node = terminal_node->compressed_suffix_link;
+// произвольные байты: таблицы занимают столько столбцов, сколько байтов встречается в словах
+void BenchmarkAlphabet() {
+    const size_t text_size = 16 << 20;
+    std::mt19937 gen(2023);
+    std::vector<std::pair<std::string, std::string>> corpora = {
+            {"binary", RandomBytes(gen, text_size)},
+            {"utf-8", Utf8Text(gen, text_size)},
+    };
+    for (const auto&[name, text] : corpora) {
+        for (int n_words : {100, 10000}) {
+            std::vector<std::string> words;
+            std::uniform_int_distribution<size_t> length(4, 12);
+            std::uniform_int_distribution<size_t> position(0, text_size - 12);
+            for (int i = 0; i < n_words; ++i) {
+                words.push_back(text.substr(position(gen), length(gen)));
             }
+            Bor bor(words);
+            bor.Compile();
+            size_t found = 0;
+            double find_time = MeasureSeconds([&] {
+                for (const std::vector<int>& positions : bor.FindOnString(text)) {
+                    found += positions.size();
+                }
+            });
+            std::cout << name << ", " << n_words << " words:\t" << bor.AlphabetSize() << " columns, goto table "
+                      << (bor.NodeCount() * bor.AlphabetSize() * sizeof(uint32_t) >> 10) << " KB (256 columns: "
+                      << (bor.NodeCount() * 256 * sizeof(uint32_t) >> 10) << " KB)\tFindOnString "
+                      << (text_size >> 20) / find_time << " MB/s\t(" << found << " occurrences)\n";
         }
-        return ans;
-    }
-
-    void Print() {
-        std::string pref;
-        PrintNodes(pref, root);
     }
+}
 
-    void PrintNodes(std::string& pref, Node* node) {
-        if (node == nullptr) {
-            return;
+// префильтр на тексте, где вхождения редки: слова с редкими первыми байтами, слова из частых букв
+// (помогает таблица пар) и словарь, для которого префильтр отключается
+void BenchmarkPrefilter() {
+    const size_t text_size = 64 << 20;
+    std::mt19937 gen(2023);
+    std::string text = RandomString(gen, text_size, 26);
+    auto random_words = [&](int n_words) {
+        std::vector<std::string> words;
+        for (int i = 0; i < n_words; ++i) {
+            words.push_back(RandomString(gen, 8, 26));
         }
-        if (node->terminal) {
-            std::cout << pref << "\n";
+        return words;
+    };
+    std::vector<std::pair<std::string, std::vector<std::string>>> dictionaries = {
+            {"4 rare first bytes", {"ERROR", "FATAL", "WARN", "panic:"}},
+            {"10 random words   ", random_words(10)},
+            {"100 random words  ", random_words(100)},
+    };
+    for (const auto&[name, words] : dictionaries) {
+        // редкие вхождения: одно на мегабайт
+        for (size_t pos = 0; pos + 16 < text_size; pos += 1 << 20) {
+            text.replace(pos, words[pos % words.size()].size(), words[pos % words.size()]);
         }
-        for (size_t i = 0; i < node->children.size(); ++i) {
-            pref.push_back(Node::GetLetter(i));
-            PrintNodes(pref, node->children[i]);
-            pref.pop_back();
+        std::cout << name << ":";
+        for (bool with_prefilter : {false, true}) {
+            Bor bor(words);
+            bor.Compile(with_prefilter);
+            size_t found = 0;
+            double time = MeasureSeconds([&] {
+                for (const std::vector<int>& positions : bor.FindOnString(text)) {
+                    found += positions.size();
+                }
+            });
+            std::cout << (with_prefilter ? "\tprefilter " : "\tautomaton ") << (text_size >> 20) / time << " MB/s ("
+                      << found << ")";
         }
+        std::cout << "\n";
     }
+}
 
-    void PrintStructure() {
-        std::string pref;
-        PrintStructureNodes(pref, root);
+void BenchmarkSink() {
+    const size_t text_size = 16 << 20;
+    std::mt19937 gen(2023);
+    // много вхождений: 100 коротких слов над алфавитом из 4 букв
+    std::string text = RandomString(gen, text_size, 4);
+    std::vector<std::string> words;
+    for (int i = 0; i < 100; ++i) {
+        words.push_back(RandomString(gen, 6, 4));
     }
-
-    void PrintStructureNodes(std::string& pref, Node* node) {
-        std::cout << pref << ":" << "\n";
-        std::cout << "from\t" << node << "\tto\t";
-        for (size_t i = 0; i < node->children.size(); ++i) {
-            if (node->children[i] != nullptr) {
-                std::cout << Node::GetLetter(i) << " " << node->children[i] << "\t";
-            }
+    std::vector<Bor::Match> buffer(1 << 16);
+    for (bool compiled : {false, true}) {
+        Bor bor(words);
+        if (compiled) {
+            bor.Compile();
         }
-        std::cout << "\n";
-        std::cout << "suffix link:\t" << node->suffix_link << "\n";
-        std::cout << "compressed_suffix_link:\t" << node->compressed_suffix_link << "\n";
-        std::cout << "\n";
-        for (size_t i = 0; i < node->children.size(); ++i) {
-            if (node->children[i] != nullptr) {
-                pref.push_back(Node::GetLetter(i));
-                PrintStructureNodes(pref, node->children[i]);
-                pref.pop_back();
+        size_t found = 0;
+        double vector_time = MeasureSeconds([&] {
+            for (const std::vector<int>& positions : bor.FindOnString(text)) {
+                found += positions.size();
             }
-        }
+        });
+        size_t sunk = 0;
+        double sink_time = MeasureSeconds([&] {
+            bor.FindOnString(std::string_view(text), [&](int, size_t) {
+                ++sunk;
+                return true;
+            });
+        });
+        size_t buffered = 0;
+        double buffer_time = MeasureSeconds([&] {
+            buffered = bor.FindOnString(text, std::span<Bor::Match>(buffer));
+        });
+        size_t first = 0;
+        double first_time = MeasureSeconds([&] {
+            bor.FindOnString(std::string_view(text), [&](int, size_t position) {
+                first = position;
+                return false;
+            });
+        });
+        std::cout << (compiled ? "compiled: " : "trie:     ") << "vector " << vector_time << " s (" << found
+                  << ")\tsink " << sink_time << " s (" << sunk << ")\tbuffer " << buffer_time << " s (" << buffered
+                  << ")\tfirst match " << first_time * 1e6 << " us (" << first << ")\n";
     }
+}
 
-    ~Bor() {
-        FreeNodes(root);
+// набор ключевых слов, известный при компиляции: StaticBor против Bor, построенного и скомпилированного при запуске
+using KeywordBor = StaticBor<"string", "search", "suffix", "array", "tree", "pattern", "index", "text", "people",
+                             "water", "little", "called", "words", "could", "first", "would", "their", "which",
+                             "about", "there", "other", "these", "many", "time">;
+
+std::vector<std::string> KeywordList() {
+    return {"string", "search", "suffix", "array", "tree", "pattern", "index", "text", "people", "water", "little",
+            "called", "words", "could", "first", "would", "their", "which", "about", "there", "other", "these",
+            "many", "time"};
+}
+
+void BenchmarkStatic() {
+    std::mt19937 gen(7);
+    std::string text = NaturalText(gen, 64 << 20);
+    std::vector<std::string> words = KeywordList();
+    std::unique_ptr<Bor> bor;
+    double startup_time = MeasureSeconds([&] {
+        bor = std::make_unique<Bor>(words);
+        bor->Compile();
+    });
+    std::cout << "startup: Bor + Compile " << startup_time * 1e6 << " us	StaticBor 0 us (" << KeywordBor::StateCount()
+              << " states, " << sizeof(KeywordBor::State) << "-byte state, " << KeywordBor::TableBytes()
+              << " bytes of read-only tables)\n";
+    auto report = [&](const std::string& name, auto&& scan) {
+        size_t found = 0;
+        double time = MeasureSeconds([&] { found = scan(); });
+        std::cout << name << (text.size() >> 20) / time << " MB/s\t(" << found << " occurrences)\n";
+    };
+    report("Bor sink:         ", [&] {
+        size_t found = 0;
+        bor->FindOnString(std::string_view(text), [&](int, size_t) {
+            ++found;
+            return true;
+        });
+        return found;
+    });
+    report("StaticBor sink:   ", [&] {
+        size_t found = 0;
+        KeywordBor::FindOnString(std::string_view(text), [&](int, size_t) {
+            ++found;
+            return true;
+        });
+        return found;
+    });
+    report("Bor count:        ", [&] {
+        std::vector<int> counts = bor->CountOnString(text);
+        return static_cast<size_t>(std::accumulate(counts.begin(), counts.end(), 0));
+    });
+    report("StaticBor count:  ", [&] {
+        std::array<int, 24> counts = KeywordBor::CountOnString(text);
+        return static_cast<size_t>(std::accumulate(counts.begin(), counts.end(), 0));
+    });
+}
+
+// задержка вставки и удаления одного слова в DynamicBor против полной перестройки Bor и цена поиска по уровням
+void BenchmarkDynamic() {
+    std::mt19937 gen(11);
+    const int n_words = 200000;
+    std::uniform_int_distribution<size_t> length(4, 12);
+    std::vector<std::string> words;
+    for (int i = 0; i < n_words; ++i) {
+        words.push_back(RandomString(gen, length(gen), 26));
+    }
+    double rebuild_time = MeasureSeconds([&] { Bor bor(words); });
+    DynamicBor dynamic(words);
+    auto report = [](const std::string& name, std::vector<double>& latencies) {
+        std::sort(latencies.begin(), latencies.end());
+        double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+        std::cout << name << ":\tmean " << total / latencies.size() * 1e6 << " us\tp50 "
+                  << latencies[latencies.size() / 2] * 1e6 << " us\tp99 " << latencies[latencies.size() * 99 / 100] * 1e6
+                  << " us\tmax " << latencies.back() * 1e6 << " us\n";
+    };
+    std::cout << "full rebuild of " << n_words << " words:\t" << rebuild_time * 1000 << " ms\n";
+    std::vector<double> latencies;
+    std::vector<int> ids;
+    for (int i = 0; i < 20000; ++i) {
+        std::string word = RandomString(gen, length(gen), 26);
+        latencies.push_back(MeasureSeconds([&] { ids.push_back(dynamic.Insert(word)); }));
+    }
+    report("Insert", latencies);
+    latencies.clear();
+    std::uniform_int_distribution<int> any_id(0, n_words + 20000 - 1);
+    for (int i = 0; i < 20000; ++i) {
+        int id = any_id(gen);
+        latencies.push_back(MeasureSeconds([&] { dynamic.Erase(id); }));
     }
-};
+    report("Erase ", latencies);
+    std::string text = RandomString(gen, 16 << 20, 26);
+    Bor bor(words);
+    size_t found = 0;
+    double static_time = MeasureSeconds([&] {
+        bor.FindOnString(std::string_view(text), [&](int, size_t) { return ++found != 0; });
+    });
+    double dynamic_time = MeasureSeconds([&] {
+        dynamic.FindOnString(std::string_view(text), [&](int, size_t) { return ++found != 0; });
+    });
+    std::cout << "scan: Bor " << (text.size() >> 20) / static_time << " MB/s\tDynamicBor ("
+              << dynamic.LevelCount() << " levels) " << (text.size() >> 20) / dynamic_time << " MB/s\n";
+}
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        BenchmarkConstruction();
+        BenchmarkScan();
+        BenchmarkStartup();
+        BenchmarkParallelScan();
+        BenchmarkStream();
+        BenchmarkAlphabet();
+        BenchmarkPrefilter();
+        BenchmarkSink();
+        BenchmarkDynamic();
+        BenchmarkStatic();
+        return 0;
+    }
+    {
+        // StaticBor строится при компиляции и находит то же, что Bor
+        static_assert(StaticBor<"he", "she", "his", "hers">::CountOnString("ushers")[3] == 1);
+        using SmallBor = StaticBor<"a", "ab", "bab", "bc", "bca", "c", "caa">;
+        using WideBor = StaticBor<"abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc",
+                                  "bcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabca",
+                                  "cabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcab", "ab", "ca">;
+        static_assert(std::is_same_v<SmallBor::State, uint8_t> && std::is_same_v<WideBor::State, uint16_t>);
+        // повторяющиеся слова: как и Bor, находит только последнее из одинаковых
+        using DuplicateBor = StaticBor<"ab", "b", "ab", "bab", "b">;
+        static_assert(DuplicateBor::CountOnString("abab")[0] == 0 && DuplicateBor::CountOnString("abab")[2] == 2);
+        Bor duplicate_bor({"ab", "b", "ab", "bab", "b"});
+        duplicate_bor.Compile();
+        Bor small_bor({"a", "ab", "bab", "bc", "bca", "c", "caa"});
+        small_bor.Compile();
+        Bor wide_bor({"abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc",
+                      "bcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabca",
+                      "cabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcab", "ab", "ca"});
+        wide_bor.Compile();
+        std::mt19937 gen(24);
+        for (int t = 0; t < 200; ++t) {
+            std::string text = t % 2 == 0 ? RandomString(gen, t * 3, 3 + t % 3) : std::string(t, 'x');
+            if (t % 5 == 0) {
+                text += "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc";
+            }
+            assert(SmallBor::FindOnString(text) == small_bor.FindOnString(text));
+            assert(WideBor::FindOnString(text) == wide_bor.FindOnString(text));
+            assert(DuplicateBor::FindOnString(text) == duplicate_bor.FindOnString(text));
+            std::vector<std::pair<int, size_t>> expected;
+            std::vector<std::pair<int, size_t>> found;
+            wide_bor.FindOnString(std::string_view(text), [&](int pattern, size_t position) {
+                expected.emplace_back(pattern, position);
+                return true;
+            });
+            WideBor::FindOnString(std::string_view(text), [&](int pattern, size_t position) {
+                found.emplace_back(pattern, position);
+                return true;
+            });
+            assert(found == expected);
+            std::array<int, 7> counts = SmallBor::CountOnString(text);
+            std::vector<int> expected_counts = small_bor.CountOnString(text);
+            assert(std::equal(counts.begin(), counts.end(), expected_counts.begin(), expected_counts.end()));
+        }
+    }
+    {
+        // счетчики: "ushers" - 6 переходов и 3 вхождения (she, he, hers) в обоих режимах поиска
+        Bor bor({"he", "she", "his", "hers"});
+        stats::Scope scope;
+        size_t found = bor.FindOnString("ushers")[0].size();
+        stats::Snapshot delta = scope.Delta();
+        bor.Compile();
+        stats::Scope compiled_scope;
+        found += bor.FindOnString("ushers")[3].size();
+        stats::Snapshot compiled_delta = compiled_scope.Delta();
+        assert(found == 2);
+        if constexpr (stats::ENABLED) {
+            assert(delta[stats::Counter::BorTransitions] == 6 && delta[stats::Counter::BorMatches] == 3);
+            assert(delta[stats::Counter::BorSuffixLinkHops] > 0);
+            assert(compiled_delta[stats::Counter::BorMatches] == 3 && compiled_delta.Calls(stats::Timer::BorScan) == 1);
+        } else {
+            assert(delta[stats::Counter::BorMatches] == 0 && compiled_delta[stats::Counter::BorMatches] == 0);
+        }
+    }
     std::vector<std::string> words = {"abcd", "aab", "aac", "bac", "baa", "ba", "aa", "a"};
     Bor bor(words);
 //    bor.Print();
@@ -233,6 +506,298 @@ int main() {
         }
         std::cout << "\n";
     }
+    // скомпилированный автомат находит те же вхождения
+    Bor compiled_bor(words);
+    compiled_bor.Compile();
+    assert(compiled_bor.CountOnString(s) == occur);
+    assert(compiled_bor.FindOnString(s) == occur_pos);
+    {
+        // произвольные байты, в том числе '\0' и байты старше 127, и байты текста, которых нет в словах
+        std::mt19937 gen(8);
+        const std::string bytes = {'\0', '\x7f', '\x80', '\xff', 'a', '$'};
+        auto random_bytes = [&](size_t size, size_t alphabet_size) {
+            std::uniform_int_distribution<size_t> byte(0, alphabet_size - 1);
+            std::string str(size, '\0');
+            for (char& c : str) {
+                c = bytes[byte(gen)];
+            }
+            return str;
+        };
+        for (int t = 0; t < 100; ++t) {
+            std::vector<std::string> patterns;
+            for (int i = 0; i < 1 + t % 8; ++i) {
+                patterns.push_back(random_bytes(1 + (i + t) % 5, 1 + t % 4));
+            }
+            // у одинаковых слов общая терминальная вершина, поэтому слова различны
+            std::sort(patterns.begin(), patterns.end());
+            patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+            std::string text = random_bytes(t * 4, bytes.size());
+            std::vector<std::vector<int>> expected(patterns.size());
+            for (size_t j = 0; j < patterns.size(); ++j) {
+                for (size_t pos = text.find(patterns[j]); pos != std::string::npos;
+                     pos = text.find(patterns[j], pos + 1)) {
+                    expected[j].push_back(pos);
+                }
+            }
+            Bor trie(patterns);
+            assert(trie.FindOnString(text) == expected);
+            trie.Compile();
+            assert(trie.FindOnString(text) == expected);
+        }
+        Bor utf8({"ёж", "жёлтый", "ж"});
+        utf8.Compile();
+        assert(utf8.CountOnString("жёлтый ёж и ещё ёжик") == std::vector<int>({2, 1, 3}));
+    }
+    {
+        // префильтр находит те же кандидаты, что и проверка каждой позиции, при любом ядре
+        std::mt19937 gen(9);
+        const std::string bytes = "ab\n\xff";
+        for (int t = 0; t < 200; ++t) {
+            std::vector<std::pair<uint8_t, int>> pairs;
+            std::uniform_int_distribution<int> byte(0, bytes.size() - 1);
+            for (int i = 0; i < 1 + t % 6; ++i) {
+                int second = i % 3 == 2 ? PairPrefilter::ANY : static_cast<unsigned char>(bytes[byte(gen)]);
+                pairs.emplace_back(bytes[byte(gen)], second);
+            }
+            std::string text(t * 3, '\0');
+            for (char& c : text) {
+                c = gen() % 8 == 0 ? bytes[byte(gen)] : 'x';
+            }
+            auto matches = [&](size_t pos) {
+                for (auto[first, second] : pairs) {
+                    if (static_cast<uint8_t>(text[pos]) == first &&
+                        (pos + 1 == text.size() || second == PairPrefilter::ANY ||
+                         static_cast<uint8_t>(text[pos + 1]) == second)) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            for (bool allow_avx2 : {false, true}) {
+                PairPrefilter prefilter(pairs, allow_avx2);
+                assert(prefilter.Active());
+                for (size_t begin = 0; begin <= text.size(); begin += 1 + t % 5) {
+                    size_t expected = begin;
+                    while (expected < text.size() && !matches(expected)) {
+                        ++expected;
+                    }
+                    assert(prefilter.Next(text.data(), begin, text.size()) == expected);
+                }
+            }
+        }
+        // с префильтром автомат находит те же вхождения
+        for (int t = 0; t < 100; ++t) {
+            std::vector<std::string> patterns;
+            for (int i = 0; i < 1 + t % 5; ++i) {
+                patterns.push_back(RandomString(gen, 1 + (i + t) % 4, 3) + RandomString(gen, t % 3, 26));
+            }
+            std::string text = RandomString(gen, t * 40, 26);
+            Bor plain(patterns);
+            plain.Compile(false);
+            Bor filtered(patterns);
+            filtered.Compile();
+            std::vector<std::vector<int>> expected = plain.FindOnString(text);
+            assert(filtered.FindOnString(text) == expected);
+            assert(filtered.CountOnString(text) == plain.CountOnString(text));
+            assert(filtered.FindOnStringParallel(text, 3) == expected);
+            std::vector<std::vector<int>> streamed(patterns.size());
+            Bor::Matcher matcher(filtered);
+            for (size_t pos = 0; pos < text.size(); pos += 7) {
+                matcher.Feed(std::string_view(text).substr(pos, 7),
+                             [&](int pattern, size_t position) { streamed[pattern].push_back(position); });
+            }
+            assert(streamed == expected);
+        }
+    }
+    {
+        // поиск по потоку, разрезанному на куски произвольной длины, находит те же вхождения
+        std::mt19937 gen(7);
+        for (int t = 0; t < 100; ++t) {
+            std::vector<std::string> patterns;
+            for (int i = 0; i < 1 + t % 8; ++i) {
+                patterns.push_back(RandomString(gen, 1 + (i * 5 + t) % 7, 1 + t % 3));
+            }
+            std::string text = RandomString(gen, t * 3, 1 + t % 3);
+            for (int compile = 0; compile < 2; ++compile) {
+                Bor trie(patterns);
+                if (compile) {
+                    trie.Compile();
+                }
+                std::vector<std::vector<int>> found(patterns.size());
+                Bor::Matcher matcher(trie);
+                std::uniform_int_distribution<size_t> chunk_size(0, 10);
+                for (size_t pos = 0; pos < text.size();) {
+                    size_t size = std::min(chunk_size(gen), text.size() - pos);
+                    matcher.Feed(std::string_view(text).substr(pos, size),
+                                 [&](int pattern, size_t position) { found[pattern].push_back(position); });
+                    pos += size;
+                }
+                assert(matcher.Offset() == text.size());
+                assert(found == trie.FindOnString(text));
+            }
+        }
+    }
+    {
+        // параллельный поиск совпадает с последовательным при любом числе кусков, в том числе на границах кусков
+        std::mt19937 gen(6);
+        for (int t = 0; t < 100; ++t) {
+            std::vector<std::string> patterns;
+            for (int i = 0; i < 1 + t % 8; ++i) {
+                patterns.push_back(RandomString(gen, 1 + (i * 7 + t) % 9, 1 + t % 3));
+            }
+            std::string text = RandomString(gen, t * 5, 1 + t % 3);
+            Bor trie(patterns);
+            std::vector<std::vector<int>> expected = trie.FindOnString(text);
+            Bor compiled_trie(patterns);
+            compiled_trie.Compile();
+            for (int n_threads : {1, 2, 3, 7, 16}) {
+                assert(trie.FindOnStringParallel(text, n_threads) == expected);
+                assert(compiled_trie.FindOnStringParallel(text, n_threads) == expected);
+            }
+        }
+    }
+    {
+        // автомат, сохраненный в файл и отображенный обратно, находит те же вхождения
+        // номер процесса в имени: обычная и _stats сборки примера под ctest -j идут одновременно
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("aho_corasick_test." + std::to_string(getpid()) + ".idx")).string();
+        std::mt19937 gen(5);
+        for (int t = 0; t < 50; ++t) {
+            std::vector<std::string> patterns;
+            for (int i = 0; i < 1 + t % 10; ++i) {
+                patterns.push_back(RandomString(gen, 1 + i % 4, 1 + t % 4));
+            }
+            std::string text = RandomString(gen, 200, 1 + t % 4);
+            Bor original(patterns);
+            original.Save(path);
+            Bor loaded = Bor::Load(path);
+            assert(loaded.CountOnString(text) == original.CountOnString(text));
+            assert(loaded.FindOnString(text) == original.FindOnString(text));
+            // доверенный файл загружается без проверки таблиц и отвечает так же
+            assert(Bor::Load(path, true).FindOnString(text) == loaded.FindOnString(text));
+        }
+        // переход за пределы таблицы при целом заголовке тоже не принимается
+        {
+            Bor(std::vector<std::string>{"ab", "bc", "abc"}).Save(path);
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            index_file::Header header{};
+            file.read(reinterpret_cast<char*>(&header), sizeof(header));
+            std::vector<index_file::SectionEntry> table(header.section_count);
+            file.read(reinterpret_cast<char*>(table.data()), table.size() * sizeof(index_file::SectionEntry));
+            auto goto_section = std::ranges::find(table, Bor::GOTO_SECTION, &index_file::SectionEntry::id);
+            assert(goto_section != table.end());
+            const uint32_t bad_state = 1u << 20;
+            file.seekp(goto_section->offset);
+            file.write(reinterpret_cast<const char*>(&bad_state), sizeof(bad_state));
+        }
+        bool corrupt_rejected = false;
+        try {
+            Bor::Load(path);
+        } catch (const std::runtime_error&) {
+            corrupt_rejected = true;
+        }
+        assert(corrupt_rejected);
+        // испорченный заголовок не принимается
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.write("XXXX", 4);
+        }
+        bool rejected = false;
+        try {
+            Bor::Load(path);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+        std::filesystem::remove(path);
+    }
+
+    {
+        // поиск через sink и в буфер дает те же вхождения, что и векторный интерфейс
+        std::mt19937 gen(13);
+        std::string text = RandomString(gen, 5000, 3);
+        std::vector<std::string> dictionary;
+        for (int i = 0; i < 30; ++i) {
+            dictionary.push_back(RandomString(gen, 1 + gen() % 5, 3));
+        }
+        std::sort(dictionary.begin(), dictionary.end());
+        dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+        for (bool compiled : {false, true}) {
+            Bor trie(dictionary);
+            if (compiled) {
+                trie.Compile();
+            }
+            std::vector<std::vector<int>> expected = trie.FindOnString(text);
+            std::vector<std::vector<int>> sunk(dictionary.size());
+            std::vector<Bor::Match> all;
+            bool finished = trie.FindOnString(std::string_view(text), [&](int pattern, size_t position) {
+                sunk[pattern].push_back(position);
+                all.push_back({pattern, position});
+                return true;
+            });
+            assert(finished);
+            assert(sunk == expected);
+            // остановка на первом вхождении
+            std::vector<Bor::Match> first;
+            finished = trie.FindOnString(std::string_view(text), [&](int pattern, size_t position) {
+                first.push_back({pattern, position});
+                return false;
+            });
+            assert(!finished && first.size() == 1);
+            assert(first[0].pattern == all[0].pattern && first[0].position == all[0].position);
+            // буфер заполняется в том же порядке и обрезается по размеру
+            for (size_t capacity : {size_t(0), size_t(1), size_t(7), all.size(), all.size() + 10}) {
+                std::vector<Bor::Match> buffer(capacity);
+                size_t written = trie.FindOnString(text, std::span<Bor::Match>(buffer));
+                assert(written == std::min(capacity, all.size()));
+                for (size_t i = 0; i < written; ++i) {
+                    assert(buffer[i].pattern == all[i].pattern && buffer[i].position == all[i].position);
+                }
+            }
+        }
+    }
+
+    {
+        // DynamicBor после вставок и удалений находит то же, что и проверка каждой позиции по живым словам
+        std::mt19937 gen(21);
+        std::string text = RandomString(gen, 2000, 3);
+        std::vector<std::string> initial;
+        for (int i = 0; i < 300; ++i) {
+            initial.push_back(RandomString(gen, 1 + gen() % 6, 3));
+        }
+        DynamicBor dynamic(initial);
+        std::vector<std::string> inserted = initial;
+        std::vector<bool> alive(initial.size(), true);
+        for (int step = 1; step <= 3000; ++step) {
+            if (gen() % 3 == 0) {
+                int id = gen() % inserted.size();
+                bool erased = dynamic.Erase(id);
+                assert(erased == alive[id]);
+                alive[id] = false;
+            } else {
+                std::string word = RandomString(gen, 1 + gen() % 6, 3);
+                int id = dynamic.Insert(word);
+                assert(id == static_cast<int>(inserted.size()));
+                inserted.push_back(word);
+                alive.push_back(true);
+            }
+            if (step % 500 == 0) {
+                std::vector<std::vector<int>> expected(inserted.size());
+                for (size_t id = 0; id < inserted.size(); ++id) {
+                    for (size_t pos = 0; alive[id] && pos + inserted[id].size() <= text.size(); ++pos) {
+                        if (text.compare(pos, inserted[id].size(), inserted[id]) == 0) {
+                            expected[id].push_back(pos);
+                        }
+                    }
+                }
+                assert(dynamic.FindOnString(text) == expected);
+                assert(dynamic.Size() == static_cast<size_t>(std::count(alive.begin(), alive.end(), true)));
+            }
+        }
+        assert(dynamic.LevelCount() > 1);
+        bool erased = dynamic.Erase(-1) || dynamic.Erase(inserted.size());
+        assert(!erased);
+    }
 
     return 0;
 }
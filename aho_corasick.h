@@ -0,0 +1,1204 @@
+#pragma once
+
+#include "index_file.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Префильтр для автомата в корне: ищет позиции, с которых может начинаться вхождение, то есть пары
+// (байт, следующий байт), с которых начинается какое-то слово. Как в Teddy, пары делятся на 8 групп, и для каждого
+// полубайта обоих байтов есть маска групп; pshufb по четырем таблицам полубайтов дает маску групп, у которых
+// совпали все полубайты. Найденные кандидаты проверяются по точной таблице пар. AVX2 выбирается во время выполнения,
+// без него при нескольких первых байтах работает сравнение SSE2, иначе - скалярный цикл по таблице пар.
+class PairPrefilter {
+public:
+    // при большем числе пар кандидатом оказывается почти каждая позиция, и префильтр только мешает
+    static constexpr int MAX_PAIRS = 64;
+    // second = ANY - слово из одного байта first, подходит любой следующий байт
+    static constexpr int ANY = -1;
+
+    PairPrefilter() = default;
+
+    // allow_avx2 = false оставляет ядро SSE2 или скалярный цикл (для сравнения ядер)
+    explicit PairPrefilter(const std::vector<std::pair<uint8_t, int>>& pairs, bool allow_avx2 = true) {
+        if (pairs.empty() || static_cast<int>(pairs.size()) > MAX_PAIRS) {
+            return;
+        }
+        active = true;
+        std::array<int, 256> first_bucket;
+        first_bucket.fill(-1);
+        for (auto[first, second] : pairs) {
+            if (first_bucket[first] == -1) {
+                first_bucket[first] = first_bytes.size() % 8;
+                first_bytes.push_back(first);
+            }
+            uint8_t bit = 1u << first_bucket[first];
+            for (int lane = 0; lane < 32; lane += 16) {
+                first_lo[lane + (first & 15)] |= bit;
+                first_hi[lane + (first >> 4)] |= bit;
+                for (int nibble = 0; nibble < 16; ++nibble) {
+                    if (second == ANY || (second & 15) == nibble) {
+                        second_lo[lane + nibble] |= bit;
+                    }
+                    if (second == ANY || (second >> 4) == nibble) {
+                        second_hi[lane + nibble] |= bit;
+                    }
+                }
+            }
+            for (int next = 0; next < 256; ++next) {
+                if (second == ANY || second == next) {
+                    exact[first * 4 + next / 64] |= 1ull << (next % 64);
+                }
+            }
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        avx2 = allow_avx2 && __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    [[nodiscard]] bool Active() const {
+        return active;
+    }
+
+    // первая позиция из [i, end), с которой может начинаться вхождение, или end;
+    // у последнего байта следующего не видно, поэтому он кандидат, если с него начинается какое-то слово
+    size_t Next(const char* data, size_t i, size_t end) const {
+#if defined(__x86_64__) || defined(__i386__)
+        if (avx2) {
+            i = NextAVX2(data, i, end);
+        } else if (first_bytes.size() <= 4) {
+            i = NextSSE2(data, i, end);
+        }
+#endif
+        for (; i + 1 < end; ++i) {
+            if (Exact(data[i], data[i + 1])) {
+                return i;
+            }
+        }
+        if (i < end && IsFirst(data[i])) {
+            return i;
+        }
+        return end;
+    }
+
+private:
+    bool active = false;
+    bool avx2 = false;
+    std::vector<uint8_t> first_bytes;
+    // таблицы полубайтов продублированы для обеих половин 256-битного регистра
+    alignas(32) std::array<uint8_t, 32> first_lo{};
+    alignas(32) std::array<uint8_t, 32> first_hi{};
+    alignas(32) std::array<uint8_t, 32> second_lo{};
+    alignas(32) std::array<uint8_t, 32> second_hi{};
+    // exact - битовая таблица 256 x 256 пар
+    std::array<uint64_t, 1024> exact{};
+
+    [[nodiscard]] bool Exact(char first, char second) const {
+        size_t pair = static_cast<unsigned char>(first) * 256 + static_cast<unsigned char>(second);
+        return exact[pair / 64] >> (pair % 64) & 1;
+    }
+
+    [[nodiscard]] bool IsFirst(char first) const {
+        size_t begin = static_cast<unsigned char>(first) * 4;
+        return (exact[begin] | exact[begin + 1] | exact[begin + 2] | exact[begin + 3]) != 0;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2"))) size_t NextAVX2(const char* data, size_t i, size_t end) const {
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lo1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(first_lo.data()));
+        const __m256i hi1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(first_hi.data()));
+        const __m256i lo2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(second_lo.data()));
+        const __m256i hi2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(second_hi.data()));
+        // второй байт читается на одну позицию правее, поэтому блоку нужно 33 байта
+        for (; i + 33 <= end; i += 32) {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+            __m256i groups = _mm256_and_si256(
+                    _mm256_shuffle_epi8(lo1, _mm256_and_si256(first, nibble)),
+                    _mm256_shuffle_epi8(hi1, _mm256_and_si256(_mm256_srli_epi16(first, 4), nibble)));
+            groups = _mm256_and_si256(groups, _mm256_shuffle_epi8(lo2, _mm256_and_si256(second, nibble)));
+            groups = _mm256_and_si256(
+                    groups, _mm256_shuffle_epi8(hi2, _mm256_and_si256(_mm256_srli_epi16(second, 4), nibble)));
+            uint32_t candidates = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(groups, zero)));
+            for (; candidates != 0; candidates &= candidates - 1) {
+                size_t pos = i + __builtin_ctz(candidates);
+                if (Exact(data[pos], data[pos + 1])) {
+                    return pos;
+                }
+            }
+        }
+        return i;
+    }
+
+    // до 4 различных первых байтов: сравнение с каждым, затем проверка пары
+    size_t NextSSE2(const char* data, size_t i, size_t end) const {
+        __m128i bytes[4];
+        for (size_t k = 0; k < 4; ++k) {
+            bytes[k] = _mm_set1_epi8(static_cast<char>(first_bytes[std::min(k, first_bytes.size() - 1)]));
+        }
+        for (; i + 17 <= end; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i equal = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, bytes[0]), _mm_cmpeq_epi8(block, bytes[1])),
+                                         _mm_or_si128(_mm_cmpeq_epi8(block, bytes[2]), _mm_cmpeq_epi8(block, bytes[3])));
+            for (uint32_t candidates = _mm_movemask_epi8(equal); candidates != 0; candidates &= candidates - 1) {
+                size_t pos = i + __builtin_ctz(candidates);
+                if (Exact(data[pos], data[pos + 1])) {
+                    return pos;
+                }
+            }
+        }
+        return i;
+    }
+#endif
+};
+
+struct Bor {
+private:
+    // старший бит перехода в таблице: у состояния есть выходы
+    static constexpr uint32_t OUTPUT_FLAG = 1u << 31;
+    // корень не бывает ребенком и сжатой суффиксной ссылкой, поэтому 0 означает "нет вершины"
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t NONE = 0;
+
+    // вершины хранятся в одном массиве и ссылаются друг на друга 32-битными индексами
+    struct Node {
+        int terminal;
+        uint32_t suffix_link;
+        uint32_t compressed_suffix_link;
+
+        explicit Node(int terminal = -1) : terminal(terminal), suffix_link(ROOT), compressed_suffix_link(NONE) {
+        }
+    };
+
+    // алфавит сжат до байтов, которые встречаются в словах: symbols[byte] - номер столбца таблиц,
+    // letters[i] - байт столбца i; столбец 0 - все остальные байты, из него нет ребер
+    std::array<uint16_t, 256> symbols{};
+    std::string letters;
+    int alphabet_size = 1;
+
+    std::vector<Node> nodes;
+    // children[node * alphabet_size + i] - переход из node по байту letters[i]
+    std::vector<uint32_t> children;
+    int n_patterns;
+    std::vector<uint32_t> pattern_sizes;
+
+    // скомпилированный автомат: goto_table[state * alphabet_size + symbol] - начало строки следующего состояния
+    // (номер состояния, умноженный на alphabet_size), выходы состояния state - outputs[output_begin[state]..output_begin[state + 1])
+    bool compiled = false;
+    std::vector<uint32_t> goto_table;
+    std::vector<uint32_t> output_begin;
+    std::vector<int> outputs;
+    // пропускает байты, на которых автомат остался бы в корне
+    PairPrefilter prefilter;
+
+    // автомат, загруженный из файла: вершин бора нет, таблицы читаются из отображенной памяти
+    std::shared_ptr<const index_file::MappedFile> mapping;
+    std::span<const uint32_t> mapped_goto_table;
+    std::span<const uint32_t> mapped_output_begin;
+    std::span<const int> mapped_outputs;
+    std::span<const uint32_t> mapped_pattern_sizes;
+
+    Bor() : n_patterns(0) {}
+
+    [[nodiscard]] std::span<const uint32_t> GotoTable() const {
+        return mapping ? mapped_goto_table : std::span<const uint32_t>(goto_table);
+    }
+
+    [[nodiscard]] std::span<const uint32_t> OutputBegin() const {
+        return mapping ? mapped_output_begin : std::span<const uint32_t>(output_begin);
+    }
+
+    [[nodiscard]] std::span<const int> Outputs() const {
+        return mapping ? mapped_outputs : std::span<const int>(outputs);
+    }
+
+    [[nodiscard]] std::span<const uint32_t> PatternSizes() const {
+        return mapping ? mapped_pattern_sizes : std::span<const uint32_t>(pattern_sizes);
+    }
+
+    uint32_t NewNode() {
+        nodes.emplace_back();
+        children.resize(children.size() + alphabet_size, NONE);
+        return nodes.size() - 1;
+    }
+
+    uint32_t* Children(uint32_t node) {
+        return &children[node * alphabet_size];
+    }
+
+    [[nodiscard]] const uint32_t* Children(uint32_t node) const {
+        return &children[node * alphabet_size];
+    }
+
+    [[nodiscard]] uint32_t At(uint32_t node, char c) const {
+        return children[node * alphabet_size + Symbol(c)];
+    }
+
+    [[nodiscard]] uint32_t Symbol(char c) const {
+        return symbols[static_cast<unsigned char>(c)];
+    }
+
+    // нумерует байты, встречающиеся в словах, по возрастанию начиная с 1
+    void MakeAlphabet(const std::vector<std::string>& words) {
+        std::array<bool, 256> occurs{};
+        for (const std::string& word : words) {
+            for (char c : word) {
+                occurs[static_cast<unsigned char>(c)] = true;
+            }
+        }
+        letters = std::string(1, '\0');
+        for (int c = 0; c < 256; ++c) {
+            if (occurs[c]) {
+                symbols[c] = letters.size();
+                letters.push_back(static_cast<char>(c));
+            }
+        }
+        alphabet_size = letters.size();
+    }
+
+    void MakeSuffixLinks() {
+        nodes[ROOT].suffix_link = ROOT;
+        std::queue<uint32_t> bfs;
+        for (int i = 0; i < alphabet_size; ++i) {
+            uint32_t node = Children(ROOT)[i];
+            if (node == NONE) {
+                continue;
+            }
+            nodes[node].suffix_link = ROOT;
+            bfs.push(node);
+        }
+        while (!bfs.empty()) {
+            uint32_t node = bfs.front();
+            bfs.pop();
+            for (int i = 0; i < alphabet_size; ++i) {
+                uint32_t next_node = Children(node)[i];
+                if (next_node == NONE) {
+                    continue;
+                }
+                uint32_t parent_node = nodes[node].suffix_link;
+                while (parent_node != ROOT && Children(parent_node)[i] == NONE) {
+                    parent_node = nodes[parent_node].suffix_link;
+                }
+                if (Children(parent_node)[i] == NONE) {
+                    nodes[next_node].suffix_link = ROOT;
+                } else {
+                    nodes[next_node].suffix_link = Children(parent_node)[i];
+                }
+                bfs.push(next_node);
+            }
+        }
+    }
+
+    void CompressSuffixLinks() {
+        std::queue<uint32_t> bfs;
+        bfs.push(ROOT);
+        while (!bfs.empty()) {
+            uint32_t node = bfs.front();
+            bfs.pop();
+            const Node& suffix_node = nodes[nodes[node].suffix_link];
+            if (suffix_node.terminal != -1) {
+                nodes[node].compressed_suffix_link = nodes[node].suffix_link;
+            } else if (suffix_node.compressed_suffix_link != NONE) {
+                nodes[node].compressed_suffix_link = suffix_node.compressed_suffix_link;
+            }
+            for (int i = 0; i < alphabet_size; ++i) {
+                if (Children(node)[i] != NONE) {
+                    bfs.push(Children(node)[i]);
+                }
+            }
+        }
+    }
+
+    // передает sink(pattern, position) вхождения, заканчивающиеся в str[report_begin..end), автомат стартует из корня
+    // с scan_begin; sink возвращает false, чтобы остановить поиск, тогда и FindInRange возвращает false
+    template <class Sink>
+    bool FindInRange(std::string_view str, size_t scan_begin, size_t report_begin, size_t end, Sink&& sink) const {
+        if (compiled) {
+            return FindInRangeCompiled(str, scan_begin, report_begin, end, sink);
+        }
+        stats::ScopedTimer timer(stats::Timer::BorScan);
+        stats::Add(stats::Counter::BorTransitions, end - scan_begin);
+        uint32_t current = ROOT;
+        for (size_t i = scan_begin; i < end; ++i) {
+            char c = str[i];
+            while (current != ROOT && At(current, c) == NONE) {
+                current = nodes[current].suffix_link;
+                stats::Add(stats::Counter::BorSuffixLinkHops);
+            }
+            if (At(current, c) == NONE) {
+                continue;
+            }
+            current = At(current, c);
+            if (i < report_begin) {
+                continue;
+            }
+            uint32_t terminal_node = nodes[current].terminal != -1 ? current : nodes[current].compressed_suffix_link;
+            while (terminal_node != NONE) {
+                int pattern = nodes[terminal_node].terminal;
+                stats::Add(stats::Counter::BorMatches);
+                if (!sink(pattern, i + 1 - pattern_sizes[pattern])) {
+                    return false;
+                }
+                terminal_node = nodes[terminal_node].compressed_suffix_link;
+            }
+        }
+        return true;
+    }
+
+    template <class Sink>
+    bool FindInRangeCompiled(std::string_view str, size_t scan_begin, size_t report_begin, size_t end,
+                             Sink&& sink) const {
+        std::span<const uint32_t> output_begin = OutputBegin();
+        std::span<const int> outputs = Outputs();
+        std::span<const uint32_t> pattern_sizes = PatternSizes();
+        uint32_t row = 0;
+        return ScanCompiled(str.data(), scan_begin, end, row, [&](size_t i, uint32_t state) {
+            if (i < report_begin) {
+                return true;
+            }
+            for (uint32_t k = output_begin[state]; k < output_begin[state + 1]; ++k) {
+                stats::Add(stats::Counter::BorMatches);
+                if (!sink(outputs[k], i + 1 - pattern_sizes[outputs[k]])) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    // проходит скомпилированный автомат по data[begin..end), начиная со строки row таблицы и оставляя в row
+    // строку последнего состояния; для каждой позиции i, где у состояния state есть выходы, вызывает on_output(i, state);
+    // если on_output вернул false, проход останавливается и ScanCompiled возвращает false
+    template <class F>
+    bool ScanCompiled(const char* data, size_t begin, size_t end, uint32_t& row, F&& on_output) const {
+        stats::ScopedTimer timer(stats::Timer::BorScan);
+        stats::Add(stats::Counter::BorTransitions, end - begin);
+        // проверка префильтра вынесена из цикла: без него цикл тот же, что до появления префильтра
+        if (prefilter.Active()) {
+            return ScanCompiled<true>(data, begin, end, row, on_output);
+        }
+        return ScanCompiled<false>(data, begin, end, row, on_output);
+    }
+
+    template <bool Prefiltered, class F>
+    bool ScanCompiled(const char* data, size_t begin, size_t end, uint32_t& row, F&& on_output) const {
+        std::span<const uint32_t> goto_table = GotoTable();
+        uint32_t current = row;
+        for (size_t i = begin; i < end; ++i) {
+            if constexpr (Prefiltered) {
+                if (current == 0) {
+                    i = prefilter.Next(data, i, end);
+                    if (i == end) {
+                        break;
+                    }
+                }
+            }
+            current = goto_table[current + Symbol(data[i])];
+            if (current & OUTPUT_FLAG) {
+                current &= ~OUTPUT_FLAG;
+                if (!on_output(i, current / alphabet_size)) {
+                    row = current;
+                    return false;
+                }
+            }
+        }
+        row = current;
+        return true;
+    }
+
+public:
+    // разделы файла индекса
+    static constexpr uint32_t META_SECTION = 1;
+    static constexpr uint32_t GOTO_SECTION = 2;
+    static constexpr uint32_t OUTPUT_BEGIN_SECTION = 3;
+    static constexpr uint32_t OUTPUTS_SECTION = 4;
+    static constexpr uint32_t PATTERN_SIZES_SECTION = 5;
+    static constexpr uint32_t SYMBOLS_SECTION = 6;
+
+    explicit Bor(const std::vector<std::string>& words) {
+        stats::ScopedTimer timer(stats::Timer::BorBuild);
+        MakeAlphabet(words);
+        NewNode();
+        n_patterns = words.size();
+        pattern_sizes.resize(n_patterns);
+        for (size_t j = 0; j < words.size(); ++j) {
+            const std::string& word = words[j];
+            pattern_sizes[j] = word.size();
+            uint32_t current = ROOT;
+            for (char c : word) {
+                uint32_t next = At(current, c);
+                if (next == NONE) {
+                    // NewNode() может переместить массив children, поэтому индекс берем заново
+                    next = NewNode();
+                    Children(current)[Symbol(c)] = next;
+                }
+                current = next;
+            }
+            nodes[current].terminal = j;
+        }
+
+        MakeSuffixLinks();
+        CompressSuffixLinks();
+    }
+
+    // пары первых двух байтов слов по таблице переходов: состояния нумеруются в порядке обхода в ширину,
+    // поэтому вершины глубины 1 - это состояния 1..число первых байтов, а переход из них в состояние с большим
+    // номером - переход по второму байту слова; поэтому префильтр строится и для загруженного автомата
+    void MakePrefilter() {
+        std::span<const uint32_t> goto_table = GotoTable();
+        uint32_t depth_one = 0;
+        for (int c = 0; c < alphabet_size; ++c) {
+            depth_one += goto_table[c] != 0;
+        }
+        std::vector<std::pair<uint8_t, int>> pairs;
+        for (int first = 0; first < 256 && static_cast<int>(pairs.size()) <= PairPrefilter::MAX_PAIRS; ++first) {
+            uint32_t row = goto_table[symbols[first]];
+            if (row == 0) {
+                continue;
+            }
+            if (row & OUTPUT_FLAG) {
+                pairs.emplace_back(first, PairPrefilter::ANY);
+                continue;
+            }
+            for (int second = 0; second < 256; ++second) {
+                if ((goto_table[row + symbols[second]] & ~OUTPUT_FLAG) / alphabet_size > depth_one) {
+                    pairs.emplace_back(first, second);
+                }
+            }
+        }
+        prefilter = PairPrefilter(pairs);
+    }
+
+    // строит плотную таблицу переходов, после чего поиск делает один переход по таблице на символ;
+    // with_prefilter - пропускать векторным префильтром участки текста, где не начинается ни одно слово
+    void Compile(bool with_prefilter = true) {
+        stats::ScopedTimer timer(stats::Timer::BorCompile);
+        // нумеруем вершины в порядке обхода в ширину: суффиксная ссылка ведет в уже занумерованную вершину
+        std::vector<uint32_t> order = {ROOT};
+        std::vector<uint32_t> state(nodes.size());
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (int i = 0; i < alphabet_size; ++i) {
+                uint32_t next_node = Children(order[k])[i];
+                if (next_node != NONE) {
+                    state[next_node] = order.size();
+                    order.push_back(next_node);
+                }
+            }
+        }
+        if (nodes.size() * alphabet_size >= OUTPUT_FLAG) {
+            throw std::length_error("goto table does not fit 31-bit offsets");
+        }
+        goto_table.assign(nodes.size() * alphabet_size, 0);
+        output_begin.assign(nodes.size() + 1, 0);
+        outputs.clear();
+        for (uint32_t node : order) {
+            uint32_t* row = &goto_table[state[node] * alphabet_size];
+            const uint32_t* link_row = &goto_table[state[nodes[node].suffix_link] * alphabet_size];
+            for (int i = 0; i < alphabet_size; ++i) {
+                if (Children(node)[i] != NONE) {
+                    row[i] = state[Children(node)[i]];
+                } else if (node != ROOT) {
+                    row[i] = link_row[i];
+                }
+            }
+            uint32_t terminal_node = nodes[node].terminal != -1 ? node : nodes[node].compressed_suffix_link;
+            for (; terminal_node != NONE; terminal_node = nodes[terminal_node].compressed_suffix_link) {
+                outputs.push_back(nodes[terminal_node].terminal);
+            }
+            output_begin[state[node] + 1] = outputs.size();
+        }
+        for (uint32_t& next_state : goto_table) {
+            bool has_output = output_begin[next_state] != output_begin[next_state + 1];
+            next_state *= alphabet_size;
+            if (has_output) {
+                next_state |= OUTPUT_FLAG;
+            }
+        }
+        compiled = true;
+        prefilter = PairPrefilter();
+        if (with_prefilter) {
+            MakePrefilter();
+        }
+    }
+
+    // сохраняет скомпилированный автомат (при необходимости компилирует его)
+    void Save(const std::string& path) {
+        if (!compiled) {
+            Compile();
+        }
+        const uint32_t meta[] = {static_cast<uint32_t>(n_patterns), static_cast<uint32_t>(alphabet_size)};
+        index_file::Writer writer(index_file::Kind::AhoCorasick);
+        writer.AddSection(META_SECTION, std::span<const uint32_t>(meta));
+        writer.AddSection(SYMBOLS_SECTION, std::span<const uint16_t>(symbols));
+        writer.AddSection(GOTO_SECTION, GotoTable());
+        writer.AddSection(OUTPUT_BEGIN_SECTION, OutputBegin());
+        writer.AddSection(OUTPUTS_SECTION, Outputs());
+        writer.AddSection(PATTERN_SIZES_SECTION, PatternSizes());
+        writer.Write(path);
+    }
+
+    // отображает сохраненный автомат в память; у загруженного бора работает только поиск.
+    // Таблицы проверяются одним проходом: переходы ведут в существующие состояния, выходы состояний идут подряд
+    // и ссылаются на существующие слова, поэтому испорченный файл не заставит поиск читать за пределами отображения.
+    // trusted - пропустить этот проход для своих файлов, когда важно время загрузки
+    static Bor Load(const std::string& path, bool trusted = false) {
+        Bor bor;
+        bor.mapping = std::make_shared<const index_file::MappedFile>(path, index_file::Kind::AhoCorasick);
+        std::span<const uint32_t> meta = bor.mapping->Section<uint32_t>(META_SECTION);
+        std::span<const uint16_t> symbols = bor.mapping->Section<uint16_t>(SYMBOLS_SECTION);
+        bor.mapped_goto_table = bor.mapping->Section<uint32_t>(GOTO_SECTION);
+        bor.mapped_output_begin = bor.mapping->Section<uint32_t>(OUTPUT_BEGIN_SECTION);
+        bor.mapped_outputs = bor.mapping->Section<int>(OUTPUTS_SECTION);
+        bor.mapped_pattern_sizes = bor.mapping->Section<uint32_t>(PATTERN_SIZES_SECTION);
+        if (meta.size() != 2 || meta[1] == 0 || meta[1] > 257 || symbols.size() != 256 ||
+            std::ranges::any_of(symbols, [&](uint16_t symbol) { return symbol >= meta[1]; }) ||
+            bor.mapped_pattern_sizes.size() != meta[0] || bor.mapped_output_begin.size() < 2 ||
+            bor.mapped_goto_table.size() != (bor.mapped_output_begin.size() - 1) * meta[1] ||
+            bor.mapped_output_begin.back() != bor.mapped_outputs.size()) {
+            throw std::runtime_error(path + ": inconsistent automaton sections");
+        }
+        if (!trusted) {
+            uint32_t alphabet = meta[1];
+            uint32_t table_size = bor.mapped_goto_table.size();
+            // переход - начало строки состояния внутри таблицы
+            bool valid_goto = std::ranges::all_of(bor.mapped_goto_table, [&](uint32_t next) {
+                next &= ~OUTPUT_FLAG;
+                return next % alphabet == 0 && next < table_size;
+            });
+            bool valid_outputs = bor.mapped_output_begin.front() == 0 &&
+                                 std::ranges::is_sorted(bor.mapped_output_begin) &&
+                                 std::ranges::all_of(bor.mapped_outputs, [&](int pattern) {
+                                     return pattern >= 0 && static_cast<uint32_t>(pattern) < meta[0];
+                                 });
+            if (!valid_goto || !valid_outputs) {
+                throw std::runtime_error(path + ": corrupt automaton tables");
+            }
+        }
+        bor.n_patterns = meta[0];
+        bor.alphabet_size = meta[1];
+        std::copy(symbols.begin(), symbols.end(), bor.symbols.begin());
+        bor.compiled = true;
+        bor.MakePrefilter();
+        return bor;
+    }
+
+    [[nodiscard]] std::vector<int> CountOnString(const std::string& str) const {
+        if (compiled) {
+            return CountOnStringCompiled(str);
+        }
+        uint32_t current = ROOT;
+        std::vector<int> ans;
+        ans.resize(n_patterns);
+        for (char c : str) {
+            while (current != ROOT && At(current, c) == NONE) {
+                current = nodes[current].suffix_link;
+            }
+            if (At(current, c) == NONE) {
+                continue;
+            }
+            current = At(current, c);
+            uint32_t terminal_node = nodes[current].terminal != -1 ? current : nodes[current].compressed_suffix_link;
+            while (terminal_node != NONE) {
+                ++ans[nodes[terminal_node].terminal];
+                terminal_node = nodes[terminal_node].compressed_suffix_link;
+            }
+        }
+        return ans;
+    }
+
+    [[nodiscard]] std::vector<std::vector<int>> FindOnString(const std::string& str) const {
+        std::vector<std::vector<int>> ans(n_patterns);
+        FindInRange(str, 0, 0, str.size(), [&](int pattern, size_t position) {
+            ans[pattern].push_back(position);
+            return true;
+        });
+        return ans;
+    }
+
+    // вхождения по одному, без выделения памяти: sink(pattern, position) вызывается в порядке концов вхождений;
+    // если sink вернул false (например, нужно только первое вхождение), поиск останавливается и возвращается false
+    template <class Sink>
+    bool FindOnString(std::string_view str, Sink&& sink) const {
+        return FindInRange(str, 0, 0, str.size(), sink);
+    }
+
+    struct Match {
+        int pattern;
+        size_t position;
+    };
+
+    // пишет вхождения в заранее выделенный буфер и останавливается, когда он заполнен;
+    // возвращает число записанных вхождений
+    size_t FindOnString(std::string_view str, std::span<Match> buffer) const {
+        size_t size = 0;
+        if (!buffer.empty()) {
+            FindInRange(str, 0, 0, str.size(), [&](int pattern, size_t position) {
+                buffer[size++] = {pattern, position};
+                return size < buffer.size();
+            });
+        }
+        return size;
+    }
+
+    // то же, что FindOnString, но строка делится на n_threads кусков, которые обрабатываются параллельно;
+    // кусок начинает автомат на (длина самого длинного слова - 1) символов раньше своей границы
+    // и сообщает только вхождения, заканчивающиеся внутри него, поэтому каждое вхождение найдется ровно один раз
+    [[nodiscard]] std::vector<std::vector<int>> FindOnStringParallel(const std::string& str, int n_threads) const {
+        size_t max_size = 0;
+        for (uint32_t size : PatternSizes()) {
+            max_size = std::max<size_t>(max_size, size);
+        }
+        size_t n_chunks = std::min<size_t>(std::max(n_threads, 1), str.size() / std::max<size_t>(max_size, 1));
+        if (n_chunks <= 1) {
+            return FindOnString(str);
+        }
+        std::vector<std::vector<std::vector<int>>> chunk_ans(n_chunks, std::vector<std::vector<int>>(n_patterns));
+        std::vector<std::thread> workers;
+        for (size_t chunk = 0; chunk < n_chunks; ++chunk) {
+            size_t begin = str.size() * chunk / n_chunks;
+            size_t end = str.size() * (chunk + 1) / n_chunks;
+            size_t scan_begin = begin >= max_size ? begin - max_size + 1 : 0;
+            workers.emplace_back([&, chunk, begin, end, scan_begin] {
+                FindInRange(str, scan_begin, begin, end, [&](int pattern, size_t position) {
+                    chunk_ans[chunk][pattern].push_back(position);
+                    return true;
+                });
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        // куски упорядочены по концам вхождений, а у одного слова конец однозначно задает начало
+        std::vector<std::vector<int>> ans(n_patterns);
+        for (int j = 0; j < n_patterns; ++j) {
+            size_t total = 0;
+            for (const auto& part : chunk_ans) {
+                total += part[j].size();
+            }
+            ans[j].reserve(total);
+            for (const auto& part : chunk_ans) {
+                ans[j].insert(ans[j].end(), part[j].begin(), part[j].end());
+            }
+        }
+        return ans;
+    }
+
+    [[nodiscard]] std::vector<int> CountOnStringCompiled(const std::string& str) const {
+        std::span<const uint32_t> output_begin = OutputBegin();
+        std::span<const int> outputs = Outputs();
+        std::vector<int> ans(n_patterns);
+        uint32_t row = 0;
+        ScanCompiled(str.data(), 0, str.size(), row, [&](size_t, uint32_t state) {
+            for (uint32_t k = output_begin[state]; k < output_begin[state + 1]; ++k) {
+                ++ans[outputs[k]];
+            }
+            return true;
+        });
+        return ans;
+    }
+
+    [[nodiscard]] std::vector<std::vector<int>> FindOnStringCompiled(const std::string& str) const {
+        std::vector<std::vector<int>> ans(n_patterns);
+        FindInRangeCompiled(str, 0, 0, str.size(), [&](int pattern, size_t position) {
+            ans[pattern].push_back(position);
+            return true;
+        });
+        return ans;
+    }
+
+    // поиск по потоку: хранит состояние автомата и число уже прочитанных символов,
+    // поэтому строку можно подавать кусками (например, блоками read или окнами mmap) без копирования;
+    // бор должен жить дольше Matcher и не изменяться, пока тот используется
+    class Matcher {
+    public:
+        explicit Matcher(const Bor& bor) : bor(bor) {}
+
+        // on_match(pattern, position) вызывается для каждого вхождения, position - смещение от начала потока
+        template <class F>
+        void Feed(std::string_view chunk, F&& on_match) {
+            if (bor.compiled) {
+                std::span<const uint32_t> output_begin = bor.OutputBegin();
+                std::span<const int> outputs = bor.Outputs();
+                std::span<const uint32_t> pattern_sizes = bor.PatternSizes();
+                bor.ScanCompiled(chunk.data(), 0, chunk.size(), state, [&](size_t i, uint32_t output_state) {
+                    for (uint32_t k = output_begin[output_state]; k < output_begin[output_state + 1]; ++k) {
+                        on_match(outputs[k], offset + i + 1 - pattern_sizes[outputs[k]]);
+                    }
+                    return true;
+                });
+            } else {
+                for (size_t i = 0; i < chunk.size(); ++i) {
+                    char c = chunk[i];
+                    while (state != ROOT && bor.At(state, c) == NONE) {
+                        state = bor.nodes[state].suffix_link;
+                    }
+                    if (bor.At(state, c) == NONE) {
+                        continue;
+                    }
+                    state = bor.At(state, c);
+                    uint32_t terminal_node = bor.nodes[state].terminal != -1 ? state : bor.nodes[state].compressed_suffix_link;
+                    for (; terminal_node != NONE; terminal_node = bor.nodes[terminal_node].compressed_suffix_link) {
+                        int pattern = bor.nodes[terminal_node].terminal;
+                        on_match(pattern, offset + i + 1 - bor.pattern_sizes[pattern]);
+                    }
+                }
+            }
+            offset += chunk.size();
+        }
+
+        // сколько символов потока уже обработано
+        [[nodiscard]] size_t Offset() const {
+            return offset;
+        }
+
+        // начать новый поток
+        void Reset() {
+            state = ROOT;
+            offset = 0;
+        }
+
+    private:
+        const Bor& bor;
+        // вершина бора или, у скомпилированного автомата, начало строки состояния в goto_table
+        uint32_t state = ROOT;
+        size_t offset = 0;
+    };
+
+    // число столбцов таблиц: встречающиеся в словах байты и столбец для остальных
+    [[nodiscard]] int AlphabetSize() const {
+        return alphabet_size;
+    }
+
+    [[nodiscard]] size_t NodeCount() const {
+        return nodes.size();
+    }
+
+    // байты, занятые вершинами бора (без скомпилированной таблицы)
+    [[nodiscard]] size_t NodeBytes() const {
+        return nodes.capacity() * sizeof(Node) + children.capacity() * sizeof(uint32_t);
+    }
+
+    void Print() {
+        std::string pref;
+        PrintNodes(pref, ROOT);
+    }
+
+    void PrintNodes(std::string& pref, uint32_t node) {
+        if (nodes[node].terminal != -1) {
+            std::cout << pref << "\n";
+        }
+        for (int i = 0; i < alphabet_size; ++i) {
+            if (Children(node)[i] != NONE) {
+                pref.push_back(letters[i]);
+                PrintNodes(pref, Children(node)[i]);
+                pref.pop_back();
+            }
+        }
+    }
+
+    void PrintStructure() {
+        std::string pref;
+        PrintStructureNodes(pref, ROOT);
+    }
+
+    void PrintStructureNodes(std::string& pref, uint32_t node) {
+        std::cout << pref << ":" << "\n";
+        std::cout << "from\t" << node << "\tto\t";
+        for (int i = 0; i < alphabet_size; ++i) {
+            if (Children(node)[i] != NONE) {
+                std::cout << letters[i] << " " << Children(node)[i] << "\t";
+            }
+        }
+        std::cout << "\n";
+        std::cout << "suffix link:\t" << nodes[node].suffix_link << "\n";
+        std::cout << "compressed_suffix_link:\t" << nodes[node].compressed_suffix_link << "\n";
+        std::cout << "\n";
+        for (int i = 0; i < alphabet_size; ++i) {
+            if (Children(node)[i] != NONE) {
+                pref.push_back(letters[i]);
+                PrintStructureNodes(pref, Children(node)[i]);
+                pref.pop_back();
+            }
+        }
+    }
+};
+
+// изменяемый набор слов: Bentley-Saxe над неизменяемыми борами. Уровень i держит до BASE * GROWTH^i слов;
+// новое слово сливается с уровнем 0, переполненный уровень целиком переливается в следующий, поэтому
+// каждое слово перестраивается O(log N) раз, а вставка не трогает больших уровней, пока они не переполнятся.
+// Удаление ставит надгробие; уровень, в котором удалена больше половины слов, перестраивается без них.
+// Слово получает id при вставке, вхождения сообщаются по id
+class DynamicBor {
+public:
+    static constexpr size_t BASE = 256;
+    static constexpr size_t GROWTH = 4;
+
+    DynamicBor() = default;
+
+    explicit DynamicBor(const std::vector<std::string>& words) {
+        std::vector<std::pair<std::string, int>> items;
+        for (const std::string& word : words) {
+            items.emplace_back(word, NewId());
+        }
+        size_t level = 0;
+        while (Capacity(level) < items.size()) {
+            ++level;
+        }
+        levels.resize(level + 1);
+        Build(level, std::move(items));
+    }
+
+    // возвращает id слова
+    int Insert(const std::string& word) {
+        int id = NewId();
+        std::vector<std::pair<std::string, int>> carry = {{word, id}};
+        for (size_t level = 0;; ++level) {
+            if (level == levels.size()) {
+                levels.emplace_back();
+            }
+            // удаленные слова уровня при слиянии выбрасываются
+            for (auto& item : levels[level].items) {
+                if (!erased[item.second]) {
+                    carry.push_back(std::move(item));
+                }
+            }
+            if (carry.size() <= Capacity(level)) {
+                Build(level, std::move(carry));
+                return id;
+            }
+            levels[level] = Level();
+        }
+    }
+
+    // возвращает false, если слова с таким id нет
+    bool Erase(int id) {
+        if (id < 0 || id >= static_cast<int>(erased.size()) || erased[id]) {
+            return false;
+        }
+        erased[id] = true;
+        --live;
+        Level& level = levels[level_of[id]];
+        if (++level.erased * 2 > level.items.size()) {
+            std::vector<std::pair<std::string, int>> items;
+            for (auto& item : level.items) {
+                if (!erased[item.second]) {
+                    items.push_back(std::move(item));
+                }
+            }
+            Build(level_of[id], std::move(items));
+        }
+        return true;
+    }
+
+    // sink(id, position) для каждого вхождения живого слова; уровни проходятся по очереди, поэтому
+    // вхождения разных слов приходят не по порядку позиций; false из sink останавливает поиск
+    template <class Sink>
+    bool FindOnString(std::string_view str, Sink&& sink) const {
+        for (const Level& level : levels) {
+            if (!level.bor) {
+                continue;
+            }
+            bool finished = level.bor->FindOnString(str, [&](int pattern, size_t position) {
+                for (uint32_t k = level.id_begin[pattern]; k < level.id_begin[pattern + 1]; ++k) {
+                    if (!erased[level.ids[k]] && !sink(level.ids[k], position)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            if (!finished) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // позиции вхождений по id (по возрастанию); у удаленных слов пусто
+    std::vector<std::vector<int>> FindOnString(const std::string& str) const {
+        std::vector<std::vector<int>> ans(erased.size());
+        FindOnString(std::string_view(str), [&](int id, size_t position) {
+            ans[id].push_back(position);
+            return true;
+        });
+        return ans;
+    }
+
+    [[nodiscard]] size_t Size() const {
+        return live;
+    }
+
+    [[nodiscard]] size_t LevelCount() const {
+        size_t count = 0;
+        for (const Level& level : levels) {
+            count += !level.items.empty();
+        }
+        return count;
+    }
+
+private:
+    struct Level {
+        std::vector<std::pair<std::string, int>> items;  // (слово, id), отсортированы по слову
+        std::unique_ptr<Bor> bor;  // по различным словам уровня; у пустого уровня его нет
+        std::vector<uint32_t> id_begin;  // слову бора j соответствуют ids[id_begin[j]..id_begin[j + 1])
+        std::vector<int> ids;
+        size_t erased = 0;
+    };
+
+    std::vector<Level> levels;
+    std::vector<bool> erased;
+    std::vector<int> level_of;
+    size_t live = 0;
+
+    static size_t Capacity(size_t level) {
+        size_t capacity = BASE;
+        for (size_t i = 0; i < level; ++i) {
+            capacity *= GROWTH;
+        }
+        return capacity;
+    }
+
+    int NewId() {
+        erased.push_back(false);
+        level_of.push_back(0);
+        ++live;
+        return erased.size() - 1;
+    }
+
+    // одинаковые слова (вставленные несколько раз) становятся одним словом бора с несколькими id
+    void Build(size_t index, std::vector<std::pair<std::string, int>> items) {
+        std::sort(items.begin(), items.end());
+        Level level;
+        std::vector<std::string> words;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (i == 0 || items[i].first != items[i - 1].first) {
+                words.push_back(items[i].first);
+                level.id_begin.push_back(i);
+            }
+            level.ids.push_back(items[i].second);
+            level_of[items[i].second] = index;
+        }
+        level.id_begin.push_back(items.size());
+        if (!words.empty()) {
+            level.bor = std::make_unique<Bor>(words);
+        }
+        level.items = std::move(items);
+        levels[index] = std::move(level);
+    }
+};
+
+// строковый литерал как параметр шаблона: StaticBor<"he", "she", "his", "hers">
+template <size_t N>
+struct FixedString {
+    char chars[N]{};
+
+    constexpr FixedString(const char (&str)[N]) {
+        std::copy_n(str, N, chars);
+    }
+
+    [[nodiscard]] constexpr std::string_view View() const {
+        return {chars, N - 1};
+    }
+};
+
+// Автомат Ахо-Корасик для набора слов, известного при компиляции: таблица переходов и выходы строятся constexpr
+// и лежат в данных только для чтения, построения при запуске нет. Тип состояния - наименьший из uint8_t, uint16_t,
+// uint32_t, в который помещается номер состояния и флаг выхода в старшем бите; строки таблицы выровнены до степени
+// двойки, поэтому строка состояния находится сдвигом. Вхождения те же и в том же порядке, что у Bor после Compile(),
+// в том числе для повторяющихся слов: находится только последнее из одинаковых
+template <FixedString... Words>
+class StaticBor {
+private:
+    static constexpr std::array<std::string_view, sizeof...(Words)> WORDS = {Words.View()...};
+
+    // автомат во время построения; живет только внутри константного выражения
+    struct Automaton {
+        // символ 0 - байты, которых нет в словах
+        std::array<uint8_t, 256> symbols{};
+        size_t stride_bits = 0;
+        // goto_table[(state << stride_bits) + symbol] - следующее состояние
+        std::vector<uint32_t> goto_table;
+        std::vector<uint32_t> output_begin;
+        std::vector<uint32_t> outputs;
+    };
+
+    static constexpr Automaton Build() {
+        Automaton automaton;
+        size_t alphabet_size = 1;
+        for (std::string_view word : WORDS) {
+            for (char c : word) {
+                automaton.symbols[static_cast<unsigned char>(c)] = 1;
+            }
+        }
+        for (int c = 0; c < 256; ++c) {
+            if (automaton.symbols[c] != 0) {
+                automaton.symbols[c] = alphabet_size++;
+            }
+        }
+        while ((size_t{1} << automaton.stride_bits) < alphabet_size) {
+            ++automaton.stride_bits;
+        }
+        size_t stride = size_t{1} << automaton.stride_bits;
+        // бор: children[(node << stride_bits) + symbol], 0 - нет ребра (в корень ребер нет)
+        std::vector<uint32_t> children(stride);
+        std::vector<std::vector<uint32_t>> own(1);
+        for (size_t j = 0; j < WORDS.size(); ++j) {
+            uint32_t node = 0;
+            for (char c : WORDS[j]) {
+                size_t edge = (node << automaton.stride_bits) + automaton.symbols[static_cast<unsigned char>(c)];
+                if (children[edge] == 0) {
+                    children[edge] = own.size();
+                    own.emplace_back();
+                    children.resize(children.size() + stride);
+                }
+                node = children[edge];
+            }
+            // как у Bor: из одинаковых слов выход есть только у последнего
+            own[node].assign(1, j);
+        }
+        // обход в ширину: суффиксная ссылка ведет в вершину меньшей глубины, у которой переходы уже готовы;
+        // выходы вершины - ее слова, затем выходы суффиксной ссылки (от длинных слов к коротким)
+        size_t n_states = own.size();
+        std::vector<uint32_t> link(n_states);
+        std::vector<std::vector<uint32_t>> outputs(n_states);
+        automaton.goto_table.assign(n_states << automaton.stride_bits, 0);
+        std::vector<uint32_t> order = {0};
+        for (size_t k = 0; k < order.size(); ++k) {
+            uint32_t node = order[k];
+            outputs[node] = own[node];
+            if (node != 0) {
+                outputs[node].insert(outputs[node].end(), outputs[link[node]].begin(), outputs[link[node]].end());
+            }
+            for (size_t c = 0; c < stride; ++c) {
+                size_t edge = (static_cast<size_t>(node) << automaton.stride_bits) + c;
+                size_t link_edge = (static_cast<size_t>(link[node]) << automaton.stride_bits) + c;
+                uint32_t child = children[edge];
+                if (child == 0) {
+                    automaton.goto_table[edge] = node == 0 ? 0 : automaton.goto_table[link_edge];
+                    continue;
+                }
+                link[child] = node == 0 ? 0 : automaton.goto_table[link_edge];
+                automaton.goto_table[edge] = child;
+                order.push_back(child);
+            }
+        }
+        automaton.output_begin.push_back(0);
+        for (size_t node = 0; node < n_states; ++node) {
+            automaton.outputs.insert(automaton.outputs.end(), outputs[node].begin(), outputs[node].end());
+            automaton.output_begin.push_back(automaton.outputs.size());
+        }
+        return automaton;
+    }
+
+    static constexpr size_t STATES = Build().output_begin.size() - 1;
+    static constexpr size_t STRIDE_BITS = Build().stride_bits;
+    static constexpr size_t OUTPUTS_SIZE = Build().outputs.size();
+
+public:
+    using State = std::conditional_t<STATES <= 128, uint8_t, std::conditional_t<STATES <= 32768, uint16_t, uint32_t>>;
+
+private:
+    static constexpr State OUTPUT_FLAG = State{1} << (8 * sizeof(State) - 1);
+
+    static constexpr std::array<uint8_t, 256> SYMBOLS = Build().symbols;
+
+    static constexpr std::array<State, (STATES << STRIDE_BITS)> GOTO_TABLE = [] {
+        Automaton automaton = Build();
+        std::array<State, (STATES << STRIDE_BITS)> table{};
+        for (size_t i = 0; i < table.size(); ++i) {
+            uint32_t next = automaton.goto_table[i];
+            bool has_output = automaton.output_begin[next] != automaton.output_begin[next + 1];
+            table[i] = static_cast<State>(next | (has_output ? OUTPUT_FLAG : 0));
+        }
+        return table;
+    }();
+
+    static constexpr std::array<uint32_t, STATES + 1> OUTPUT_BEGIN = [] {
+        Automaton automaton = Build();
+        std::array<uint32_t, STATES + 1> output_begin{};
+        std::copy(automaton.output_begin.begin(), automaton.output_begin.end(), output_begin.begin());
+        return output_begin;
+    }();
+
+    static constexpr std::array<uint32_t, OUTPUTS_SIZE> OUTPUTS = [] {
+        Automaton automaton = Build();
+        std::array<uint32_t, OUTPUTS_SIZE> outputs{};
+        std::copy(automaton.outputs.begin(), automaton.outputs.end(), outputs.begin());
+        return outputs;
+    }();
+
+    static constexpr std::array<uint32_t, sizeof...(Words)> PATTERN_SIZES = {Words.View().size()...};
+
+    static constexpr State Next(State state, char c) {
+        return GOTO_TABLE[(static_cast<size_t>(state) << STRIDE_BITS) + SYMBOLS[static_cast<unsigned char>(c)]];
+    }
+
+public:
+    [[nodiscard]] static constexpr size_t StateCount() {
+        return STATES;
+    }
+
+    [[nodiscard]] static constexpr size_t TableBytes() {
+        return sizeof(GOTO_TABLE) + sizeof(OUTPUT_BEGIN) + sizeof(OUTPUTS) + sizeof(SYMBOLS);
+    }
+
+    // как Bor::FindOnString(str, sink): sink(pattern, position) в порядке концов вхождений, false останавливает поиск
+    template <class Sink>
+    static constexpr bool FindOnString(std::string_view str, Sink&& sink) {
+        State current = 0;
+        for (size_t i = 0; i < str.size(); ++i) {
+            current = Next(current, str[i]);
+            if (current & OUTPUT_FLAG) {
+                current &= ~OUTPUT_FLAG;
+                for (uint32_t k = OUTPUT_BEGIN[current]; k < OUTPUT_BEGIN[current + 1]; ++k) {
+                    if (!sink(static_cast<int>(OUTPUTS[k]), i + 1 - PATTERN_SIZES[OUTPUTS[k]])) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] static std::vector<std::vector<int>> FindOnString(const std::string& str) {
+        std::vector<std::vector<int>> ans(sizeof...(Words));
+        FindOnString(std::string_view(str), [&](int pattern, size_t position) {
+            ans[pattern].push_back(position);
+            return true;
+        });
+        return ans;
+    }
+
+    [[nodiscard]] static constexpr std::array<int, sizeof...(Words)> CountOnString(std::string_view str) {
+        std::array<int, sizeof...(Words)> ans{};
+        State current = 0;
+        for (char c : str) {
+            current = Next(current, c);
+            if (current & OUTPUT_FLAG) {
+                current &= ~OUTPUT_FLAG;
+                for (uint32_t k = OUTPUT_BEGIN[current]; k < OUTPUT_BEGIN[current + 1]; ++k) {
+                    ++ans[OUTPUTS[k]];
+                }
+            }
+        }
+        return ans;
+    }
+};
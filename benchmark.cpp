@@ -0,0 +1,190 @@
+#include "aho_corasick.h"
+#include "corpus.h"
+#include "stats.h"
+#include "suffix_massive.h"
+#include "suffix_tree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Общий бенчмарк трех индексов на одних и тех же синтетических текстах: время построения, пропускная способность
+// и задержки запросов, пиковая память. Каждый замер идет в отдельном процессе: пиковый RSS относится только к нему,
+// а нехватка памяти на больших размерах не обрывает остальные замеры. В сборке с STRING_SEARCH_STATS после каждой
+// строки печатаются счетчики замера в JSON.
+//
+// usage: benchmark [max_size] [engine...]
+//   max_size - наибольший размер текста (1K, 32M, 1G, ...), по умолчанию 32M
+//   engine   - aho, tree или array, по умолчанию все три
+
+const std::vector<size_t> SIZES = {1 << 10, 32 << 10, 1 << 20, 32 << 20, 1 << 30};
+const int QUERY_COUNT = 20000;
+// Ахо-Корасик: словарь из подстрок текста, запрос - проход по куску текста
+const int DICTIONARY_SIZE = 1000;
+const size_t CHUNK_SIZE = 4096;
+
+struct Corpus {
+    std::string name;
+    std::function<std::string(std::mt19937&, size_t)> make;
+};
+
+struct Engine {
+    std::string name;
+    // строит индекс по тексту и возвращает функцию одного запроса (возвращает число вхождений)
+    std::function<std::function<size_t(size_t)>(const std::string&, const std::vector<std::string>&)> build;
+};
+
+std::string FormatSize(size_t size) {
+    if (size >= (1 << 30)) {
+        return std::to_string(size >> 30) + "G";
+    }
+    if (size >= (1 << 20)) {
+        return std::to_string(size >> 20) + "M";
+    }
+    if (size >= (1 << 10)) {
+        return std::to_string(size >> 10) + "K";
+    }
+    return std::to_string(size);
+}
+
+size_t ParseSize(const std::string& str) {
+    size_t size = std::stoull(str);
+    switch (str.back()) {
+        case 'G': case 'g':
+            return size << 30;
+        case 'M': case 'm':
+            return size << 20;
+        case 'K': case 'k':
+            return size << 10;
+        default:
+            return size;
+    }
+}
+
+long PeakRssKilobytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// случайные подстроки текста длины от 4 до 64
+std::vector<std::string> SamplePatterns(std::mt19937& gen, const std::string& str, int count) {
+    std::vector<std::string> patterns;
+    std::uniform_int_distribution<size_t> length(4, std::min<size_t>(64, str.size()));
+    for (int i = 0; i < count; ++i) {
+        size_t pattern_length = length(gen);
+        std::uniform_int_distribution<size_t> position(0, str.size() - pattern_length);
+        patterns.push_back(str.substr(position(gen), pattern_length));
+    }
+    return patterns;
+}
+
+std::vector<Engine> MakeEngines() {
+    return {
+            {"aho", [](const std::string& str, const std::vector<std::string>& patterns) {
+                std::vector<std::string> words(patterns.begin(),
+                                               patterns.begin() + std::min<size_t>(DICTIONARY_SIZE, patterns.size()));
+                auto bor = std::make_shared<Bor>(words);
+                bor->Compile();
+                return std::function<size_t(size_t)>([bor, &str](size_t query) {
+                    size_t begin = query * CHUNK_SIZE % str.size();
+                    size_t found = 0;
+                    bor->FindOnString(std::string_view(str).substr(begin, CHUNK_SIZE), [&](int, size_t) {
+                        ++found;
+                        return true;
+                    });
+                    return found;
+                });
+            }},
+            {"tree", [](const std::string& str, const std::vector<std::string>& patterns) {
+                auto tree = std::make_shared<SuffixTree>(str);
+                return std::function<size_t(size_t)>([tree, &patterns](size_t query) {
+                    return static_cast<size_t>(tree->Count(patterns[query]));
+                });
+            }},
+            {"array", [](const std::string& str, const std::vector<std::string>& patterns) {
+                auto array = std::make_shared<SuffixArray>(str, SuffixArray::Builder::SAIS);
+                return std::function<size_t(size_t)>([array, &patterns](size_t query) {
+                    return array->SearchRange(patterns[query]).size();
+                });
+            }},
+    };
+}
+
+// один замер в дочернем процессе; строка результата печатается им же
+void Run(const Engine& engine, const Corpus& corpus, size_t size) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::mt19937 gen(7);
+        std::string str = corpus.make(gen, size);
+        std::vector<std::string> patterns = SamplePatterns(gen, str, QUERY_COUNT);
+        long rss_before = PeakRssKilobytes();
+        std::function<size_t(size_t)> query;
+        double build_time = MeasureSeconds([&] { query = engine.build(str, patterns); });
+        std::vector<double> latencies(QUERY_COUNT);
+        size_t found = 0;
+        for (int i = 0; i < QUERY_COUNT; ++i) {
+            latencies[i] = MeasureSeconds([&] { found += query(i); });
+        }
+        double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::setw(6) << engine.name << std::setw(10) << corpus.name << std::setw(6) << FormatSize(size)
+                  << "\tbuild " << build_time * 1000 << " ms\t" << QUERY_COUNT / total << " q/s\tp50 "
+                  << latencies[QUERY_COUNT / 2] * 1e6 << " us\tp99 " << latencies[QUERY_COUNT * 99 / 100] * 1e6
+                  << " us\tpeak RSS " << (PeakRssKilobytes() - rss_before) / 1024 << " MB\t(" << found
+                  << " occurrences)\n";
+        if constexpr (stats::ENABLED) {
+            std::cout << "\tstats " << stats::Total().ToJson() << "\n";
+        }
+        std::cout.flush();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << std::setw(6) << engine.name << std::setw(10) << corpus.name << std::setw(6) << FormatSize(size)
+                  << "\tfailed (out of memory?)\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t max_size = 32 << 20;
+    if (argc > 1) {
+        max_size = ParseSize(argv[1]);
+    }
+    std::vector<std::string> selected(argv + std::min(argc, 2), argv + argc);
+    std::vector<Corpus> corpora = {
+            {"random", [](std::mt19937& gen, size_t size) { return RandomString(gen, size, 26); }},
+            {"fibonacci", [](std::mt19937&, size_t size) { return FibonacciString(size); }},
+            {"natural", [](std::mt19937& gen, size_t size) { return NaturalText(gen, size); }},
+    };
+    std::cout << "query: aho - scan of a " << CHUNK_SIZE << "-byte chunk with " << DICTIONARY_SIZE
+              << " words, tree and array - count of a substring of length 4..64\n";
+    for (const Engine& engine : MakeEngines()) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), engine.name) == selected.end()) {
+            continue;
+        }
+        for (size_t size : SIZES) {
+            if (size > max_size) {
+                break;
+            }
+            for (const Corpus& corpus : corpora) {
+                Run(engine, corpus, size);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+// Синтетические тексты для примеров и бенчмарков: при одном и том же gen получается одна и та же строка.
+
+template <class F>
+double MeasureSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline std::string RandomString(std::mt19937& gen, size_t size, int alphabet_size) {
+    std::uniform_int_distribution<int> letter(0, alphabet_size - 1);
+    std::string str(size, 'a');
+    for (char& c : str) {
+        c = static_cast<char>('a' + letter(gen));
+    }
+    return str;
+}
+
+// строка Фибоначчи: много длинных повторов, на ней вставка суффиксов работает за квадрат
+inline std::string FibonacciString(size_t size) {
+    std::string prev = "a";
+    std::string str = "ab";
+    while (str.size() < size) {
+        std::string next = str + prev;
+        prev = std::move(str);
+        str = std::move(next);
+    }
+    return str.substr(0, size);
+}
+
+// текст из английских слов с частотами по закону Ципфа (без пробелов: алфавит - только строчные буквы)
+inline std::string NaturalText(std::mt19937& gen, size_t size) {
+    static const std::vector<std::string> words = {
+            "the", "of", "and", "to", "in", "is", "that", "it", "was", "for", "on", "are", "as", "with", "his",
+            "they", "at", "be", "this", "from", "have", "or", "by", "one", "had", "not", "but", "what", "all",
+            "were", "when", "we", "there", "can", "an", "your", "which", "their", "said", "if", "do", "will",
+            "each", "about", "how", "up", "out", "them", "then", "she", "many", "some", "so", "these", "would",
+            "other", "into", "has", "more", "her", "two", "like", "him", "see", "time", "could", "no", "make",
+            "than", "first", "been", "its", "who", "now", "people", "my", "made", "over", "did", "down", "only",
+            "way", "find", "use", "may", "water", "long", "little", "very", "after", "words", "called", "just",
+            "where", "most", "know", "string", "search", "suffix", "array", "tree", "pattern", "index", "text",
+    };
+    std::vector<double> weights(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::string str;
+    str.reserve(size + 16);
+    while (str.size() < size) {
+        str += words[word(gen)];
+    }
+    str.resize(size);
+    return str;
+}
+
+// случайные байты 0..255
+inline std::string RandomBytes(std::mt19937& gen, size_t size) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::string str(size, '\0');
+    for (char& c : str) {
+        c = static_cast<char>(byte(gen));
+    }
+    return str;
+}
+
+// русский текст в UTF-8: слова с частотами по закону Ципфа через пробел
+inline std::string Utf8Text(std::mt19937& gen, size_t size) {
+    static const std::vector<std::string> words = {
+            "и", "в", "не", "на", "я", "что", "он", "с", "быть", "а", "весь", "это", "как", "она", "по", "но",
+            "они", "к", "у", "ты", "из", "мы", "за", "вы", "так", "же", "от", "сказать", "этот", "который",
+            "мочь", "человек", "о", "один", "еще", "бы", "такой", "только", "себя", "свое", "какой", "когда",
+            "строка", "поиск", "суффикс", "массив", "дерево", "образец", "индекс", "текст", "ёж", "ответ",
+    };
+    std::vector<double> weights(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::string str;
+    str.reserve(size + 32);
+    while (str.size() < size) {
+        str += words[word(gen)];
+        str += ' ';
+    }
+    str.resize(size);
+    return str;
+}
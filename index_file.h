@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Файл индекса: заголовок, таблица разделов и сами разделы. Разделы выровнены по 64 байтам,
+// поэтому после mmap массивы читаются прямо из отображенной памяти без копирования и разбора.
+//
+// заголовок (24 байта): magic "STRSRCH\0", version, endian_mark = 0x01020304, kind, section_count
+// таблица разделов: section_count записей {id (uint32), reserved (uint32), offset (uint64), size (uint64)}
+// числа записываются в порядке байт машины, endian_mark не дает открыть файл на машине с другим порядком
+namespace index_file {
+
+const char MAGIC[8] = {'S', 'T', 'R', 'S', 'R', 'C', 'H', '\0'};
+const uint32_t VERSION = 2;
+const uint32_t ENDIAN_MARK = 0x01020304;
+const size_t ALIGNMENT = 64;
+
+// что лежит в файле
+enum class Kind : uint32_t {
+    SuffixArray = 1,
+    AhoCorasick = 2,
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_mark;
+    uint32_t kind;
+    uint32_t section_count;
+};
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// собирает разделы и пишет файл; данные разделов не копируются, они должны жить до вызова Write
+class Writer {
+public:
+    explicit Writer(Kind kind) : kind(kind) {}
+
+    template <class T>
+    void AddSection(uint32_t id, std::span<const T> data) {
+        sections.push_back({id, data.data(), data.size_bytes()});
+    }
+
+    void AddSection(uint32_t id, std::string_view data) {
+        sections.push_back({id, data.data(), data.size()});
+    }
+
+    void Write(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("cannot open " + path + " for writing");
+        }
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.endian_mark = ENDIAN_MARK;
+        header.kind = static_cast<uint32_t>(kind);
+        header.section_count = sections.size();
+        std::vector<SectionEntry> table;
+        uint64_t offset = Align(sizeof(Header) + sections.size() * sizeof(SectionEntry));
+        for (const Section& section : sections) {
+            table.push_back({section.id, 0, offset, section.size});
+            offset = Align(offset + section.size);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SectionEntry));
+        uint64_t written = sizeof(Header) + table.size() * sizeof(SectionEntry);
+        for (size_t i = 0; i < sections.size(); ++i) {
+            Pad(out, table[i].offset - written);
+            out.write(static_cast<const char*>(sections[i].data), sections[i].size);
+            written = table[i].offset + sections[i].size;
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+private:
+    struct Section {
+        uint32_t id;
+        const void* data;
+        size_t size;
+    };
+
+    Kind kind;
+    std::vector<Section> sections;
+
+    static uint64_t Align(uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    static void Pad(std::ofstream& out, uint64_t size) {
+        static const char zeros[ALIGNMENT] = {};
+        out.write(zeros, size);
+    }
+};
+
+// файл индекса, отображенный в память только для чтения; разделы - представления этой памяти
+class MappedFile {
+public:
+    MappedFile(const std::string& path, Kind kind) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+        size = info.st_size;
+        if (size >= sizeof(Header)) {
+            data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED || data == nullptr) {
+            data = nullptr;
+            throw std::runtime_error("cannot map " + path);
+        }
+        const Header& header = *static_cast<const Header*>(data);
+        const char* error = nullptr;
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            error = "not an index file";
+        } else if (header.version != VERSION) {
+            error = "unsupported index version";
+        } else if (header.endian_mark != ENDIAN_MARK) {
+            error = "index written with another byte order";
+        } else if (header.kind != static_cast<uint32_t>(kind)) {
+            error = "index of another kind";
+        } else if (sizeof(Header) + static_cast<uint64_t>(header.section_count) * sizeof(SectionEntry) > size) {
+            error = "truncated section table";
+        } else {
+            const auto* table = reinterpret_cast<const SectionEntry*>(static_cast<const char*>(data) + sizeof(Header));
+            sections.assign(table, table + header.section_count);
+            for (const SectionEntry& section : sections) {
+                if (section.offset % ALIGNMENT != 0 || section.offset > size || section.size > size - section.offset) {
+                    error = "section out of file bounds";
+                }
+            }
+        }
+        if (error != nullptr) {
+            munmap(data, size);
+            data = nullptr;
+            throw std::runtime_error(path + ": " + error);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap(data, size);
+        }
+    }
+
+    template <class T>
+    std::span<const T> Section(uint32_t id) const {
+        std::string_view bytes = Bytes(id);
+        if (bytes.size() % sizeof(T) != 0) {
+            throw std::runtime_error("section size is not a multiple of the element size");
+        }
+        return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
+    }
+
+    std::string_view Bytes(uint32_t id) const {
+        for (const SectionEntry& section : sections) {
+            if (section.id == id) {
+                return {static_cast<const char*>(data) + section.offset, section.size};
+            }
+        }
+        throw std::runtime_error("missing section " + std::to_string(id));
+    }
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+    std::vector<SectionEntry> sections;
+};
+
+}  // namespace index_file
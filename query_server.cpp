@@ -0,0 +1,250 @@
+#include "query_server.h"
+#include "corpus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Request = QueryServer::Request;
+using Kind = QueryServer::Kind;
+
+// запросы вперемешку: 40% Search, 30% Contains, 20% FindOnString по куску текста, 10% RegularSearch;
+// шаблоны - подстроки текста длины от 4 до 32, в RegularSearch каждый пятый символ заменен на '?'
+std::vector<Request> MakeRequests(std::mt19937& gen, const std::string& str, int count) {
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<int> length(4, 32);
+    std::uniform_int_distribution<size_t> position(0, str.size() - 1024);
+    std::vector<Request> requests;
+    for (int i = 0; i < count; ++i) {
+        int k = kind(gen);
+        size_t start = position(gen);
+        if (k < 4) {
+            requests.push_back({Kind::Search, str.substr(start, length(gen))});
+        } else if (k < 7) {
+            requests.push_back({Kind::Contains, str.substr(start, length(gen))});
+        } else if (k < 9) {
+            requests.push_back({Kind::FindOnString, str.substr(start, 1024)});
+        } else {
+            std::string pattern = str.substr(start, length(gen));
+            for (size_t j = 2; j < pattern.size(); j += 5) {
+                pattern[j] = '?';
+            }
+            requests.push_back({Kind::RegularSearch, pattern});
+        }
+    }
+    return requests;
+}
+
+struct LoadResult {
+    double qps;
+    double p50;
+    double p99;
+};
+
+// замкнутый цикл: каждый из clients клиентов ставит запрос (или пачку из batch_size запросов), ждет ответа
+// и ставит следующий; задержка - от постановки до последнего ответа пачки
+LoadResult RunLoad(QueryServer& server, const std::vector<Request>& requests, int clients, int batch_size) {
+    std::vector<std::vector<double>> latencies(clients);
+    size_t per_client = requests.size() / clients / batch_size;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int client = 0; client < clients; ++client) {
+        threads.emplace_back([&, client] {
+            // счетчик ответов разделяется с callback: рабочий может еще вызывать notify, когда клиент уже закончил
+            auto answered = std::make_shared<std::atomic<int>>(0);
+            for (size_t round = 0; round < per_client; ++round) {
+                size_t first = (client * per_client + round) * batch_size;
+                *answered = 0;
+                auto submitted = std::chrono::steady_clock::now();
+                if (batch_size == 1) {
+                    server.Submit(requests[first], [answered](const QueryServer::Response&) {
+                        *answered = 1;
+                        answered->notify_one();
+                    });
+                } else {
+                    std::vector<Request> batch(requests.begin() + first, requests.begin() + first + batch_size);
+                    auto on_answer = [answered, batch_size](size_t, const QueryServer::Response&) {
+                        if (answered->fetch_add(1) + 1 == batch_size) {
+                            answered->notify_one();
+                        }
+                    };
+                    server.SubmitBatch(std::move(batch), on_answer);
+                }
+                for (int current = *answered; current != batch_size; current = *answered) {
+                    answered->wait(current);
+                }
+                latencies[client].push_back(
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - submitted).count());
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<double> all;
+    for (const std::vector<double>& part : latencies) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end());
+    return {static_cast<double>(all.size() * batch_size) / total_time, all[all.size() / 2],
+            all[all.size() * 99 / 100]};
+}
+
+// QPS и задержки p50/p99 в зависимости от числа рабочих потоков, по одному запросу и пачками по 32
+void BenchmarkLoad() {
+    std::mt19937 gen(7);
+    const int n = 4 << 20;
+    std::string str = NaturalText(gen, n);
+    std::vector<std::string> words = {"string", "search", "suffix", "array", "tree", "pattern", "index", "text",
+                                      "people", "water", "little", "called", "words", "could", "first", "would"};
+    auto bor = std::make_shared<Bor>(words);
+    bor->Compile();
+    QueryServer::Index index{std::make_shared<SuffixArray>(str, SuffixArray::Builder::SAIS),
+                             std::make_shared<SuffixTree>(str), bor};
+    std::vector<Request> requests = MakeRequests(gen, str, 64000);
+    const int clients = 16;
+    for (int n_threads : {1, 2, 4, 8}) {
+        QueryServer server(index, n_threads);
+        for (int batch_size : {1, 32}) {
+            LoadResult result = RunLoad(server, requests, clients, batch_size);
+            std::cout << n_threads << " threads, " << clients << " clients, batch " << batch_size << ":\t"
+                      << result.qps << " q/s\tp50 " << result.p50 * 1e6 << " us\tp99 " << result.p99 * 1e6
+                      << " us\n";
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        BenchmarkLoad();
+        return 0;
+    }
+    {
+        // арена после Reset отдает те же блоки, не выделяя новых
+        Arena arena(256);
+        std::span<int> first = arena.Allocate<int>(10);
+        std::span<int64_t> second = arena.Allocate<int64_t>(100);
+        assert(reinterpret_cast<uintptr_t>(second.data()) % alignof(int64_t) == 0);
+        size_t capacity = arena.Capacity();
+        arena.Reset();
+        std::span<int> again = arena.Allocate<int>(10);
+        arena.Allocate<int64_t>(100);
+        assert(again.data() == first.data() && arena.Capacity() == capacity);
+        ArenaVector<int> vector(arena, 1);
+        for (int i = 0; i < 1000; ++i) {
+            vector.push_back(i);
+        }
+        assert(vector.View().size() == 1000 && vector.View()[999] == 999);
+    }
+    {
+        // пул выполняет все задачи, в том числе поставленные из задач, и дорабатывает их при разрушении
+        std::atomic<int> done = 0;
+        {
+            WorkStealingPool pool(3);
+            for (int i = 0; i < 100; ++i) {
+                pool.Submit([&](int) {
+                    for (int j = 0; j < 10; ++j) {
+                        pool.Submit([&](int worker) {
+                            assert(worker >= 0 && worker < 3);
+                            ++done;
+                        });
+                    }
+                });
+            }
+        }
+        assert(done == 1000);
+    }
+    {
+        // ответы сервера совпадают с прямыми вызовами при любом числе потоков, по одному и пачками
+        std::mt19937 gen(25);
+        std::string str = NaturalText(gen, 20000);
+        auto bor = std::make_shared<Bor>(std::vector<std::string>{"the", "of", "and", "that", "search"});
+        QueryServer::Index index{std::make_shared<SuffixArray>(str), std::make_shared<SuffixTree>(str), bor};
+        std::vector<Request> requests = MakeRequests(gen, str, 500);
+        requests.push_back({Kind::Contains, "zzzz"});
+        requests.push_back({Kind::Search, "qqq"});
+        // прямые ответы: позиции или вхождения (pattern, position) подряд
+        auto expected = [&](const Request& request) {
+            std::vector<int64_t> ans;
+            switch (request.kind) {
+                case Kind::Search: {
+                    std::span<const int> found = index.array->SearchRange(request.pattern);
+                    ans.assign(found.begin(), found.end());
+                    break;
+                }
+                case Kind::RegularSearch: {
+                    std::vector<int> found = index.array->RegularSearch(request.pattern);
+                    ans.assign(found.begin(), found.end());
+                    break;
+                }
+                case Kind::Contains:
+                    ans.push_back(index.tree->contains(request.pattern));
+                    break;
+                case Kind::FindOnString:
+                    index.bor->FindOnString(std::string_view(request.pattern), [&](int pattern, size_t position) {
+                        ans.push_back(pattern);
+                        ans.push_back(position);
+                        return true;
+                    });
+                    break;
+            }
+            return ans;
+        };
+        auto flatten = [](const QueryServer::Response& response) {
+            std::vector<int64_t> ans(response.positions.begin(), response.positions.end());
+            if (response.kind == Kind::Contains) {
+                ans.push_back(response.count);
+            }
+            for (const Bor::Match& match : response.matches) {
+                ans.push_back(match.pattern);
+                ans.push_back(match.position);
+            }
+            return ans;
+        };
+        for (int n_threads : {1, 2, 3}) {
+            std::vector<std::vector<int64_t>> answers(requests.size());
+            std::vector<std::vector<int64_t>> batch_answers(requests.size());
+            {
+                QueryServer server(index, n_threads, 1024);
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    server.Submit(requests[i], [&, i](const QueryServer::Response& response) {
+                        answers[i] = flatten(response);
+                    });
+                }
+                for (size_t first = 0; first < requests.size(); first += 50) {
+                    size_t last = std::min(first + 50, requests.size());
+                    std::vector<Request> batch(requests.begin() + first, requests.begin() + last);
+                    server.SubmitBatch(std::move(batch), [&, first](size_t i, const QueryServer::Response& response) {
+                        batch_answers[first + i] = flatten(response);
+                    });
+                }
+            }
+            for (size_t i = 0; i < requests.size(); ++i) {
+                std::vector<int64_t> direct = expected(requests[i]);
+                assert(answers[i] == direct && batch_answers[i] == direct);
+            }
+        }
+        // запрос к индексу, которого у сервера нет, отклоняется сразу
+        QueryServer array_only({index.array, nullptr, nullptr}, 1);
+        bool rejected = false;
+        try {
+            array_only.Submit({Kind::Contains, "the"}, [](const QueryServer::Response&) {});
+        } catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        assert(rejected);
+    }
+    std::cout << "query server: all checks passed\n";
+    return 0;
+}
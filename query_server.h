@@ -0,0 +1,339 @@
+#pragma once
+
+#include "aho_corasick.h"
+#include "suffix_massive.h"
+#include "suffix_tree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Пул потоков с перехватом работы: у каждого рабочего своя очередь. Задачи, поставленные из рабочего потока, идут
+// в его очередь, остальные - по кругу. Рабочий берет задачи с конца своей очереди (последняя поставленная еще
+// в кэше), а когда она пуста, забирает задачи с начала чужих очередей. Задача получает номер рабочего, чтобы
+// пользоваться его ресурсами (например, ареной) без синхронизации.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(int worker)>;
+
+    explicit WorkStealingPool(int n_threads) : queues(std::max(n_threads, 1)) {
+        for (size_t worker = 0; worker < queues.size(); ++worker) {
+            threads.emplace_back([this, worker] { Run(worker); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // дорабатывает все поставленные задачи и останавливает потоки
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void Submit(Task task) {
+        size_t queue = current_pool == this ? current_worker : next_queue.fetch_add(1) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[queue].mutex);
+            queues[queue].tasks.push_back(std::move(task));
+        }
+        {
+            // под sleep_mutex, чтобы рабочий, проверяющий pending перед сном, не пропустил пробуждение
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            ++pending;
+        }
+        wake.notify_one();
+    }
+
+    [[nodiscard]] int WorkerCount() const {
+        return queues.size();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_queue = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    // поставленные и еще не взятые задачи
+    std::atomic<int64_t> pending = 0;
+    bool stopping = false;
+
+    static inline thread_local const WorkStealingPool* current_pool = nullptr;
+    static inline thread_local size_t current_worker = 0;
+
+    bool TryPop(size_t worker, Task& task) {
+        {
+            Queue& own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t shift = 1; shift < queues.size(); ++shift) {
+            Queue& victim = queues[(worker + shift) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Run(size_t worker) {
+        current_pool = this;
+        current_worker = worker;
+        while (true) {
+            Task task;
+            if (TryPop(worker, task)) {
+                --pending;
+                task(worker);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [&] { return stopping || pending > 0; });
+            if (stopping && pending == 0) {
+                return;
+            }
+        }
+    }
+};
+
+// Память одного запроса: выделение - сдвиг указателя, Reset освобождает все сразу. Блоки после Reset остаются,
+// поэтому в установившемся режиме запросы не обращаются к malloc. Только для тривиальных типов.
+class Arena {
+public:
+    explicit Arena(size_t block_size = 1 << 20) : block_size(block_size) {}
+
+    template <class T>
+    std::span<T> Allocate(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+        size_t bytes = count * sizeof(T);
+        while (current < blocks.size()) {
+            size_t begin = (offset + alignof(T) - 1) / alignof(T) * alignof(T);
+            if (begin + bytes <= blocks[current].size) {
+                offset = begin + bytes;
+                return {reinterpret_cast<T*>(blocks[current].data.get() + begin), count};
+            }
+            // в текущем блоке не хватает места, переходим к следующему
+            ++current;
+            offset = 0;
+        }
+        // new выравнивает блок не хуже alignof(std::max_align_t)
+        size_t size = std::max(block_size, bytes);
+        blocks.push_back({std::make_unique<std::byte[]>(size), size});
+        offset = bytes;
+        return {reinterpret_cast<T*>(blocks[current].data.get()), count};
+    }
+
+    void Reset() {
+        current = 0;
+        offset = 0;
+    }
+
+    [[nodiscard]] size_t Capacity() const {
+        size_t bytes = 0;
+        for (const Block& block : blocks) {
+            bytes += block.size;
+        }
+        return bytes;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    size_t block_size;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+};
+
+// массив в арене, растет удвоением; старые копии остаются в арене до Reset
+template <class T>
+class ArenaVector {
+public:
+    explicit ArenaVector(Arena& arena, size_t capacity = 64) : arena(arena), data(arena.Allocate<T>(capacity)) {}
+
+    void push_back(const T& value) {
+        if (size == data.size()) {
+            std::span<T> grown = arena.Allocate<T>(std::max<size_t>(2 * data.size(), 1));
+            std::copy(data.begin(), data.end(), grown.begin());
+            data = grown;
+        }
+        data[size++] = value;
+    }
+
+    [[nodiscard]] std::span<const T> View() const {
+        return data.first(size);
+    }
+
+private:
+    Arena& arena;
+    std::span<T> data;
+    size_t size = 0;
+};
+
+// Запросы к одному неизменяемому индексу из многих клиентов. Все запросы только читают SuffixArray, SuffixTree и Bor,
+// поэтому рабочие пула выполняют их без блокировок; результаты Search указывают прямо в суффиксный массив,
+// остальные лежат в арене рабочего и действительны только во время callback, после него арена очищается.
+class QueryServer {
+public:
+    enum class Kind {
+        // позиции pattern в порядке суффиксного массива (SuffixArray::SearchRange)
+        Search,
+        // позиции pattern с '?' по возрастанию (SuffixArray::RegularSearch)
+        RegularSearch,
+        // есть ли pattern в строке (SuffixTree::contains)
+        Contains,
+        // вхождения слов Bor в pattern - здесь pattern это текст запроса (Bor::FindOnString)
+        FindOnString,
+    };
+
+    struct Request {
+        Kind kind;
+        std::string pattern;
+    };
+
+    struct Response {
+        Kind kind;
+        // число позиций или вхождений, для Contains - 0 или 1
+        size_t count = 0;
+        std::span<const int> positions;
+        std::span<const Bor::Match> matches;
+    };
+
+    // индексы, по которым отвечает сервер; отсутствующий индекс - запросы его типа отклоняются при постановке
+    struct Index {
+        std::shared_ptr<const SuffixArray> array;
+        std::shared_ptr<const SuffixTree> tree;
+        std::shared_ptr<const Bor> bor;
+    };
+
+    using Callback = std::function<void(const Response&)>;
+    using BatchCallback = std::function<void(size_t, const Response&)>;
+
+    QueryServer(Index index, int n_threads, size_t arena_block_size = 1 << 20)
+            : index(std::move(index)), arenas(std::max(n_threads, 1)) {
+        for (Arena& arena : arenas) {
+            arena = Arena(arena_block_size);
+        }
+        pool = std::make_unique<WorkStealingPool>(n_threads);
+    }
+
+    // ответ придет в callback в одном из рабочих потоков
+    void Submit(Request request, Callback callback) {
+        Check(request);
+        pool->Submit([this, request = std::move(request), callback = std::move(callback)](int worker) {
+            Arena& arena = arenas[worker];
+            callback(Execute(request, arena));
+            arena.Reset();
+        });
+    }
+
+    // пачка выполняется одной задачей пула подряд в одной арене: callback(i, ответ на requests[i]) по порядку
+    void SubmitBatch(std::vector<Request> requests, BatchCallback callback) {
+        for (const Request& request : requests) {
+            Check(request);
+        }
+        pool->Submit([this, requests = std::move(requests), callback = std::move(callback)](int worker) {
+            Arena& arena = arenas[worker];
+            for (size_t i = 0; i < requests.size(); ++i) {
+                callback(i, Execute(requests[i], arena));
+                arena.Reset();
+            }
+        });
+    }
+
+    // выполняет запрос в вызывающем потоке; результаты - в arena (у Search - в самом индексе)
+    Response Execute(const Request& request, Arena& arena) const {
+        Response response{request.kind, 0, {}, {}};
+        switch (request.kind) {
+            case Kind::Search:
+                // отрезок самого неизменяемого индекса, копировать его в арену не нужно
+                response.positions = index.array->SearchRange(request.pattern);
+                response.count = response.positions.size();
+                break;
+            case Kind::RegularSearch: {
+                // RegularSearch сам выделяет память под куски шаблона и ответ; в арену копируется только ответ
+                std::vector<int> found = index.array->RegularSearch(request.pattern);
+                std::span<int> positions = arena.Allocate<int>(found.size());
+                std::copy(found.begin(), found.end(), positions.begin());
+                response.positions = positions;
+                response.count = positions.size();
+                break;
+            }
+            case Kind::Contains:
+                response.count = index.tree->contains(request.pattern);
+                break;
+            case Kind::FindOnString: {
+                ArenaVector<Bor::Match> matches(arena);
+                index.bor->FindOnString(std::string_view(request.pattern), [&](int pattern, size_t position) {
+                    matches.push_back({pattern, position});
+                    return true;
+                });
+                response.matches = matches.View();
+                response.count = response.matches.size();
+                break;
+            }
+        }
+        return response;
+    }
+
+    [[nodiscard]] int WorkerCount() const {
+        return pool->WorkerCount();
+    }
+
+private:
+    Index index;
+    std::vector<Arena> arenas;
+    // пул объявлен последним: он разрушается первым и дорабатывает задачи, пока арены и индекс еще живы
+    std::unique_ptr<WorkStealingPool> pool;
+
+    void Check(const Request& request) const {
+        bool available = false;
+        switch (request.kind) {
+            case Kind::Search:
+            case Kind::RegularSearch:
+                available = index.array != nullptr;
+                break;
+            case Kind::Contains:
+                available = index.tree != nullptr;
+                break;
+            case Kind::FindOnString:
+                available = index.bor != nullptr;
+                break;
+        }
+        if (!available) {
+            throw std::invalid_argument("query server has no index for this request kind");
+        }
+    }
+};
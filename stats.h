@@ -0,0 +1,224 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Счетчики и таймеры горячих путей. Включаются макросом STRING_SEARCH_STATS (опция CMake STRING_SEARCH_STATS);
+// без него Add и ScopedTimer пустые и после подстановки не оставляют в коде ничего.
+// Каждый поток пишет в свой блок без атомарных read-modify-write: Local() - счетчики текущего потока,
+// Total() - сумма по всем потокам, в том числе завершившимся. Счетчики одного запроса - разность снимков, см. Scope.
+namespace stats {
+
+#ifdef STRING_SEARCH_STATS
+inline constexpr bool ENABLED = true;
+#else
+inline constexpr bool ENABLED = false;
+#endif
+
+enum class Counter {
+    // Bor: символов текста, пройденных автоматом; переходов по суффиксным ссылкам; найденных вхождений
+    BorTransitions,
+    BorSuffixLinkHops,
+    BorMatches,
+    // SuffixArray: сравнений pattern с суффиксом в двоичном поиске и сравнений байтов в них
+    SuffixArrayProbes,
+    SuffixArrayByteComparisons,
+    // SuffixTree: разрезанных ребер при построении и переходов к детям при поиске
+    SuffixTreeSplits,
+    SuffixTreeChildLookups,
+    Count,
+};
+
+inline constexpr std::array<const char*, static_cast<size_t>(Counter::Count)> COUNTER_NAMES = {
+        "bor_transitions", "bor_suffix_link_hops", "bor_matches", "suffix_array_probes",
+        "suffix_array_byte_comparisons", "suffix_tree_splits", "suffix_tree_child_lookups",
+};
+
+enum class Timer {
+    BorBuild,
+    BorCompile,
+    BorScan,
+    SuffixArrayBuild,
+    SuffixArrayBound,
+    SuffixTreeBuild,
+    SuffixTreeFind,
+    Count,
+};
+
+inline constexpr std::array<const char*, static_cast<size_t>(Timer::Count)> TIMER_NAMES = {
+        "bor_build", "bor_compile", "bor_scan", "suffix_array_build", "suffix_array_bound", "suffix_tree_build",
+        "suffix_tree_find",
+};
+
+inline constexpr size_t COUNTERS = COUNTER_NAMES.size();
+inline constexpr size_t TIMERS = TIMER_NAMES.size();
+
+struct Snapshot {
+    std::array<uint64_t, COUNTERS> counters{};
+    std::array<uint64_t, TIMERS> timer_calls{};
+    std::array<uint64_t, TIMERS> timer_nanoseconds{};
+
+    uint64_t operator[](Counter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    uint64_t Calls(Timer timer) const {
+        return timer_calls[static_cast<size_t>(timer)];
+    }
+
+    uint64_t Nanoseconds(Timer timer) const {
+        return timer_nanoseconds[static_cast<size_t>(timer)];
+    }
+
+    Snapshot& operator+=(const Snapshot& other) {
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            counters[i] += other.counters[i];
+        }
+        for (size_t i = 0; i < TIMERS; ++i) {
+            timer_calls[i] += other.timer_calls[i];
+            timer_nanoseconds[i] += other.timer_nanoseconds[i];
+        }
+        return *this;
+    }
+
+    Snapshot operator-(const Snapshot& other) const {
+        Snapshot ans = *this;
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            ans.counters[i] -= other.counters[i];
+        }
+        for (size_t i = 0; i < TIMERS; ++i) {
+            ans.timer_calls[i] -= other.timer_calls[i];
+            ans.timer_nanoseconds[i] -= other.timer_nanoseconds[i];
+        }
+        return ans;
+    }
+
+    // {"counters": {"bor_transitions": 10, ...}, "timers": {"bor_scan": {"calls": 1, "ns": 250}, ...}}
+    [[nodiscard]] std::string ToJson() const {
+        std::string json = "{\"counters\": {";
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            json += std::string(i > 0 ? ", " : "") + "\"" + COUNTER_NAMES[i] + "\": " + std::to_string(counters[i]);
+        }
+        json += "}, \"timers\": {";
+        for (size_t i = 0; i < TIMERS; ++i) {
+            json += std::string(i > 0 ? ", " : "") + "\"" + TIMER_NAMES[i] + "\": {\"calls\": " +
+                    std::to_string(timer_calls[i]) + ", \"ns\": " + std::to_string(timer_nanoseconds[i]) + "}";
+        }
+        return json + "}}";
+    }
+};
+
+namespace detail {
+
+// блок одного потока: пишет только владелец, поэтому хватает relaxed load + store, а чтение из Total()
+// другими потоками не гонка
+struct Block {
+    std::array<std::atomic<uint64_t>, COUNTERS> counters{};
+    std::array<std::atomic<uint64_t>, TIMERS> timer_calls{};
+    std::array<std::atomic<uint64_t>, TIMERS> timer_nanoseconds{};
+};
+
+// блоки не освобождаются: счетчики завершившихся потоков остаются в Total()
+inline std::mutex registry_mutex;
+inline std::vector<std::unique_ptr<Block>> registry;
+
+inline Block& LocalBlock() {
+    thread_local Block* block = [] {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_unique<Block>());
+        return registry.back().get();
+    }();
+    return *block;
+}
+
+inline void Bump(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline Snapshot Read(const Block& block) {
+    Snapshot ans;
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        ans.counters[i] = block.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < TIMERS; ++i) {
+        ans.timer_calls[i] = block.timer_calls[i].load(std::memory_order_relaxed);
+        ans.timer_nanoseconds[i] = block.timer_nanoseconds[i].load(std::memory_order_relaxed);
+    }
+    return ans;
+}
+
+}  // namespace detail
+
+inline void Add(Counter counter, uint64_t value = 1) {
+    if constexpr (ENABLED) {
+        detail::Bump(detail::LocalBlock().counters[static_cast<size_t>(counter)], value);
+    }
+}
+
+// время от создания до разрушения добавляется к таймеру
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Timer timer) : timer(timer) {
+        if constexpr (ENABLED) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        if constexpr (ENABLED) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            detail::Block& block = detail::LocalBlock();
+            detail::Bump(block.timer_calls[static_cast<size_t>(timer)], 1);
+            detail::Bump(block.timer_nanoseconds[static_cast<size_t>(timer)],
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    Timer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+// счетчики текущего потока с его начала
+inline Snapshot Local() {
+    if constexpr (ENABLED) {
+        return detail::Read(detail::LocalBlock());
+    }
+    return {};
+}
+
+// сумма счетчиков всех потоков
+inline Snapshot Total() {
+    Snapshot ans;
+    if constexpr (ENABLED) {
+        std::lock_guard<std::mutex> lock(detail::registry_mutex);
+        for (const auto& block : detail::registry) {
+            ans += detail::Read(*block);
+        }
+    }
+    return ans;
+}
+
+// счетчики одного запроса в текущем потоке: stats::Scope scope; ...; scope.Delta()
+class Scope {
+public:
+    Scope() : start(Local()) {}
+
+    [[nodiscard]] Snapshot Delta() const {
+        return Local() - start;
+    }
+
+private:
+    Snapshot start;
+};
+
+}  // namespace stats
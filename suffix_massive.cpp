@@ -1,248 +1,478 @@
+#include "suffix_massive.h"
+#include "corpus.h"
+
 #include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <numeric>
+#include <random>
+#include <set>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-const int ALPHABET_SIZE = 26 + 1;
-
-class SuffixArray {
-public:
-    std::string str;
-    int n;
-    std::vector<int> powers;
-    std::vector<std::vector<int>> suffix_array;
-    int k;
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-    explicit SuffixArray(const std::string& input_str) : str(input_str + static_cast<char>('z' + 1)),
-                                                         n(str.size()),
-                                                         powers(powers_of_2(n)),
-                                                         suffix_array(powers.size()),
-                                                         k(suffix_array.size()) {
-        MakeSuffixArray();
+// построение и поиск на произвольных байтах: размер алфавита - число встречающихся байтов
+void BenchmarkAlphabet() {
+    std::mt19937 gen(7);
+    const int n = 4 << 20;
+    std::vector<std::pair<std::string, std::string>> corpora = {
+            {"binary", RandomBytes(gen, n)},
+            {"utf-8 ", Utf8Text(gen, n)},
+    };
+    for (const auto&[name, str] : corpora) {
+        double doubling_time = MeasureSeconds([&] { SuffixArray search(str); });
+        SuffixArray* search = nullptr;
+        double sais_time = MeasureSeconds([&] { search = new SuffixArray(str, SuffixArray::Builder::SAIS); });
+        std::uniform_int_distribution<int> length(4, 32);
+        std::uniform_int_distribution<int> position(0, n - 32);
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 100000; ++i) {
+            patterns.push_back(str.substr(position(gen), length(gen)));
+        }
+        size_t found = 0;
+        double search_time = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found += search->SearchRange(pattern).size();
+            }
+        });
+        delete search;
+        std::cout << name << " N = " << (n >> 20) << "M:\tprefix doubling " << doubling_time * 1000 << " ms\tSA-IS "
+                  << sais_time * 1000 << " ms\tSearchRange " << search_time * 1e6 / patterns.size() << " us\t("
+                  << found << " occurrences)\n";
     }
+}
 
-    void MakeSuffixArray() {
-        suffix_array[0] = count_sort();
-        for (int i = 1; i < k; ++i) {
-            std::vector<std::pair<int, int>> pairs(n);
-            for (int j = 0; j < n; ++j) {
-                pairs[j] = {suffix_array[i - 1][j], suffix_array[i - 1][(j + powers[i - 1]) % n]};
+// '?'-поиск: RegularSearch, Shift-And и прежний подсчет кандидатов в хеш-таблице на естественном тексте
+void BenchmarkWildcard() {
+    std::mt19937 gen(9);
+    const int n = 8 << 20;
+    std::string str = NaturalText(gen, n);
+    SuffixArray search(str, SuffixArray::Builder::SAIS);
+    // прежняя реализация: позиции каждого куска в unordered_map
+    auto tally = [&](const std::string& pattern) {
+        std::unordered_map<int, int> pos_counts;
+        int fragments = 0;
+        for (size_t i = 0; i < pattern.size();) {
+            size_t end = pattern.find('?', i);
+            end = end == std::string::npos ? pattern.size() : end;
+            ++fragments;
+            for (int found_pos : search.Search(pattern.substr(i, end - i))) {
+                ++pos_counts[found_pos - static_cast<int>(i)];
             }
-            suffix_array[i] = count_pair_sort(pairs);
+            i = end + 1;
         }
-        for (std::vector<int>& array : suffix_array) {
-            std::vector<int> cnt(n);
-            for (int c : array) {
-                ++cnt[c];
-            }
-            for (int i = 1; i < n; ++i) {
-                cnt[i] += cnt[i - 1];
-            }
-            std::vector<int> p(n);
-            for (int i = n - 1; i >= 0; --i) {
-                p[--cnt[array[i]]] = i;
+        size_t count = 0;
+        for (auto[found_pos, found] : pos_counts) {
+            count += found_pos >= 0 && found == fragments;
+        }
+        return count;
+    };
+    // маска: 1 - символ заменяется на '?'
+    auto make_patterns = [&](int length, const std::string& mask) {
+        std::vector<std::string> patterns;
+        std::uniform_int_distribution<int> position(0, n - length);
+        for (int i = 0; i < 20; ++i) {
+            std::string pattern = str.substr(position(gen), length);
+            for (int j = 0; j < length; ++j) {
+                if (mask[j % mask.size()] == '1') {
+                    pattern[j] = '?';
+                }
             }
-            array = p;
+            patterns.push_back(pattern);
         }
-    }
-
-    std::vector<int> Search(const std::string& pattern) {
-        if (pattern.empty()) {
-            std::vector<int> ans(str.size());
-            std::iota(ans.begin(), ans.end(), 0);
-            return ans;
+        return patterns;
+    };
+    std::vector<std::pair<std::string, std::vector<std::string>>> sets = {
+            {"16 chars, 2 '?'      ", make_patterns(16, "0000000100000001")},
+            {"8 chars, every 2nd '?'", make_patterns(8, "01")},
+            {"12 chars, 2 of 3 '?' ", make_patterns(12, "011")},
+    };
+    // хеш-таблицы замеряются последними: после их освобождения аллокатор замедляет следующие замеры
+    std::vector<std::vector<std::pair<double, size_t>>> results(sets.size());
+    for (int method = 0; method < 3; ++method) {
+        for (size_t i = 0; i < sets.size(); ++i) {
+            size_t found = 0;
+            double time = MeasureSeconds([&] {
+                for (const std::string& pattern : sets[i].second) {
+                    found += method == 0 ? search.RegularSearch(pattern).size()
+                             : method == 1 ? search.ShiftAndSearch(pattern).size()
+                             : tally(pattern);
+                }
+            });
+            results[i].emplace_back(time * 1e3 / sets[i].second.size(), found);
         }
-        int power = *std::lower_bound(powers.begin(), powers.end(), pattern.size());
-
-        int left = left_bound(pattern, power);
-        int right = right_bound(pattern, power);
-        std::vector<int> ans;
-        for (int i = left; i < right; ++i) {
-            ans.push_back(suffix_array[power][i]);
+    }
+    const char* names[] = {"\tRegularSearch ", "\tShift-And ", "\thash tally "};
+    for (size_t i = 0; i < sets.size(); ++i) {
+        std::cout << sets[i].first << ":";
+        for (int method = 0; method < 3; ++method) {
+            std::cout << names[method] << results[i][method].first << " ms (" << results[i][method].second << ")";
         }
-        return ans;
+        std::cout << "\n";
     }
+}
 
-    std::vector<int> RegularSearch(const std::string& pattern) {
-        // разбиваем паттерн на куски, ищем каждый кусок отдельно
-        std::vector<std::pair<int, std::string>> small_patterns;
-        {
-            std::string small_pattern;
-            for (size_t i = 0; i < pattern.size(); ++i) {
-                char c = pattern[i];
-                if (c == '?') {
-                    small_patterns.emplace_back(i - small_pattern.size(), small_pattern);
-                    small_pattern.clear();
-                } else {
-                    small_pattern.push_back(c);
-                }
-            }
-            if (!small_pattern.empty()) {
-                small_patterns.emplace_back(pattern.size() - small_pattern.size(), small_pattern);
+// поиск с k несовпадениями и k правками против прохода по всему тексту, k = 1..3
+void BenchmarkApproximate() {
+    std::mt19937 gen(5);
+    const int n = 4 << 20;
+    const int length = 16;
+    std::string str = NaturalText(gen, n);
+    SuffixArray search(str, SuffixArray::Builder::SAIS);
+    // проход по тексту: сравнение с каждой позицией
+    auto naive_hamming = [&](const std::string& pattern, int k) {
+        size_t count = 0;
+        for (int start = 0; start + length <= n; ++start) {
+            int mismatches = 0;
+            for (int j = 0; j < length && mismatches <= k; ++j) {
+                mismatches += str[start + j] != pattern[j];
             }
+            count += mismatches <= k;
         }
-        // прибавляем +1 к позиции, с которых начиналась бы строка, содержащая кусок одного выражения
-        std::unordered_map<int, int> pos_counts;
-        for (auto&[small_pattern_pos, small_pattern] : small_patterns) {
-            std::vector<int> res_pos = Search(small_pattern);
-            for (int found_pos : res_pos) {
-                ++pos_counts[found_pos - small_pattern_pos];
+        return count;
+    };
+    // алгоритм Селлерса по перевернутым строкам: столбец таблицы на каждый символ текста, конец вхождения
+    // в перевернутом тексте - начало в исходном
+    auto naive_edit = [&](const std::string& pattern, int k) {
+        std::string reversed(pattern.rbegin(), pattern.rend());
+        std::vector<int> column(length + 1);
+        std::iota(column.begin(), column.end(), 0);
+        size_t count = column[length] <= k;
+        for (int i = n - 1; i >= 0; --i) {
+            int diagonal = 0;
+            for (int j = 1; j <= length; ++j) {
+                int next = std::min({column[j] + 1, column[j - 1] + 1, diagonal + (reversed[j - 1] != str[i])});
+                diagonal = column[j];
+                column[j] = next;
             }
+            count += column[length] <= k;
         }
-        // те позиции, с которых бы начиналась строка, содержащая каждое выражение, имеет счётчик = число единичных выражений
-        std::vector<int> ans;
-        for (auto[found_pos, count] : pos_counts) {
-            if (found_pos >= 0 && count == static_cast<int>(small_patterns.size())) {
-                ans.push_back(found_pos);
+        return count;
+    };
+    std::uniform_int_distribution<int> position(0, n - length);
+    std::uniform_int_distribution<int> letter(0, length - 1);
+    for (int k = 1; k <= 3; ++k) {
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 20; ++i) {
+            std::string pattern = str.substr(position(gen), length);
+            for (int j = 0; j < k; ++j) {
+                pattern[letter(gen)] = static_cast<char>('a' + gen() % 26);
             }
+            patterns.push_back(pattern);
         }
-        return ans;
-    }
-
-    // возвращает наименьший суффикс, больший или равный pattern
-    int left_bound(const std::string& pattern, int power) {
-        // ищем его в (left, right]
-        int left = -1;
-        int right = n;
-        while (left + 1 < right) {
-            // (left + right) / 2 - округление вверх
-            int middle = left + (right - left + 1) / 2;
-            if (is_bigger(pattern, middle, power)) {
-                left = middle;
-            } else {
-                right = middle;
-            }
-        }
-        return right;
-    }
-
-    // возвращает наименьший суффикс, больший pattern
-    int right_bound(const std::string& pattern, int power) {
-        // ищем его в (left, right]
-        int left = 0;
-        int right = n;
-        while (left + 1 < right) {
-            int middle = left + (right - left) / 2;
-            if (is_lower(pattern, middle, power)) {
-                right = middle;
-            } else {
-                left = middle;
+        size_t found[4] = {};
+        double times[4];
+        times[0] = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found[0] += search.HammingSearch(pattern, k).size();
             }
-        }
-        return right;
+        });
+        times[1] = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found[1] += naive_hamming(pattern, k);
+            }
+        });
+        times[2] = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found[2] += search.EditSearch(pattern, k).size();
+            }
+        });
+        times[3] = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found[3] += naive_edit(pattern, k);
+            }
+        });
+        std::cout << "k = " << k << ":\tHammingSearch " << times[0] * 1e3 / patterns.size() << " ms (" << found[0]
+                  << ")\tscan " << times[1] * 1e3 / patterns.size() << " ms (" << found[1] << ")\tEditSearch "
+                  << times[2] * 1e3 / patterns.size() << " ms (" << found[2] << ")\tSellers "
+                  << times[3] * 1e3 / patterns.size() << " ms (" << found[3] << ")\n";
     }
+}
 
-    bool is_lower(const std::string& pattern, int index, int power) {
-        if (pattern < str.substr(suffix_array[power][index], power)) {
-            return true;
-        }
-        return false;
+// коллекция коротких документов: память одного обобщенного массива против массива на документ,
+// список документов Муту Кришнана против перебора всех вхождений
+void BenchmarkDocuments() {
+    std::mt19937 gen(8);
+    const int n_documents = 200000;
+    std::uniform_int_distribution<int> length(20, 100);
+    std::vector<std::string> documents;
+    size_t total = 0;
+    for (int i = 0; i < n_documents; ++i) {
+        documents.push_back(NaturalText(gen, length(gen)));
+        total += documents.back().size();
     }
-
-    bool is_bigger(const std::string& pattern, int index, int power) {
-        if (pattern > str.substr(suffix_array[power][index], power)) {
-            return true;
+    DocumentIndex* index = nullptr;
+    double build_time = MeasureSeconds([&] { index = new DocumentIndex(documents); });
+    size_t separate_bytes = 0;
+    double separate_time = MeasureSeconds([&] {
+        for (const std::string& document : documents) {
+            SuffixArray search(document, SuffixArray::Builder::SAIS);
+            separate_bytes += sizeof(SuffixArray) + search.MemoryBytes();
         }
-        return false;
+    });
+    std::cout << n_documents << " documents, " << (total >> 20) << " MB:\tDocumentIndex " << build_time * 1000
+              << " ms, " << static_cast<double>(index->MemoryBytes()) / total << " bytes/char\tarray per document "
+              << separate_time * 1000 << " ms, " << static_cast<double>(separate_bytes) / total << " bytes/char\n";
+    for (const std::string pattern : {"the", "people", "suffixarray", "waterwater"}) {
+        size_t listed = 0;
+        double list_time = MeasureSeconds([&] { listed = index->ListDocuments(pattern).size(); });
+        size_t occurrences = 0;
+        size_t located = 0;
+        double locate_time = MeasureSeconds([&] {
+            std::vector<DocumentIndex::Occurrence> found = index->Locate(pattern);
+            occurrences = found.size();
+            for (size_t i = 0; i < found.size(); ++i) {
+                located += i == 0 || found[i].document != found[i - 1].document;
+            }
+        });
+        std::cout << pattern << ":\t" << occurrences << " occurrences in " << listed << " documents\tListDocuments "
+                  << list_time * 1000 << " ms\tLocate + unique " << locate_time * 1000 << " ms (" << located << ")\n";
     }
+    delete index;
+}
 
-    bool is_equal(const std::string& pattern, int index, int power) {
-        if (pattern == str.substr(suffix_array[power][index], power)) {
-            return true;
+// анализ повторов на естественном тексте: все запросы линейны по длине
+void BenchmarkRepeats() {
+    std::mt19937 gen(10);
+    const int n = 8 << 20;
+    std::string str = NaturalText(gen, n);
+    SuffixArray search(str, SuffixArray::Builder::SAIS);
+    SuffixArray::Repeat longest{};
+    double longest_time = MeasureSeconds([&] { longest = search.LongestRepeatedSubstring(); });
+    size_t maximal = 0;
+    double maximal_time = MeasureSeconds([&] { maximal = search.MaximalRepeats(20).size(); });
+    int64_t distinct = 0;
+    double distinct_time = MeasureSeconds([&] { distinct = search.DistinctSubstrings(); });
+    std::string other = NaturalText(gen, n / 2);
+    SuffixArray::CommonSubstring common{};
+    double common_time = MeasureSeconds([&] { common = SuffixArray::LongestCommonSubstring(str, other); });
+    std::cout << "N = " << (n >> 20) << "M:\tlongest repeat " << longest.length << " (" << longest_time * 1000
+              << " ms)\tmaximal repeats >= 20: " << maximal << " (" << maximal_time * 1000 << " ms)\tdistinct "
+              << distinct << " (" << distinct_time * 1000 << " ms)\tLCS with " << (n >> 21) << "M text "
+              << common.length << " (" << common_time * 1000 << " ms, with construction)\n";
+}
+
+// построение удвоением префиксов и SA-IS на случайном, периодичном и естественном тексте
+void BenchmarkConstruction() {
+    std::mt19937 gen(7);
+    for (int n : {1 << 20, 4 << 20, 8 << 20}) {
+        std::vector<std::pair<std::string, std::string>> corpora = {
+                {"random", RandomString(gen, n, 26)},
+                {"fibonacci", FibonacciString(n)},
+                {"natural", NaturalText(gen, n)},
+        };
+        for (const auto&[name, str] : corpora) {
+            double doubling_time = MeasureSeconds([&] { SuffixArray search(str); });
+            double sais_time = MeasureSeconds([&] { SuffixArray search(str, SuffixArray::Builder::SAIS); });
+            std::cout << name << " N = " << (n >> 20) << "M:\tprefix doubling " << doubling_time * 1000
+                      << " ms\tSA-IS " << sais_time * 1000 << " ms\n";
         }
-        return false;
     }
+}
 
-    std::vector<int> count_sort() {
-        std::vector<int> cnt(ALPHABET_SIZE);
-        // подсчет каждого символа
-        for (char c : str) {
-            ++cnt[c - 'a'];
-        }
-        // cnt[i] - место, на котором должен стоять символ 'a' + i
-        for (int i = 1; i < ALPHABET_SIZE; ++i) {
-            cnt[i] += cnt[i - 1];
-        }
-        std::vector<int> p(n);
-        // p[k] = i означает, что на k месте в отсортированном списке стоит s[i]
-        for (int i = 0; i < n; ++i) {
-            p[--cnt[str[i] - 'a']] = i;
-        }
-        // раскидываем буквы по классам
-        std::vector<int> classes(n);
-        int curr_class = 0;
-        classes[0] = curr_class;
-        for (int i = 1; i < n; ++i) {
-            if (str[p[i]] != str[p[i - 1]]) {
-                ++curr_class;
-            }
-            classes[p[i]] = curr_class;
+// масштабирование параллельного удвоения префиксов по числу потоков
+void BenchmarkParallelConstruction() {
+    std::mt19937 gen(7);
+    for (int n : {1 << 20, 4 << 20, 8 << 20}) {
+        std::string str = NaturalText(gen, n);
+        std::cout << "natural N = " << (n >> 20) << "M:";
+        for (int n_threads : {1, 2, 4, 8}) {
+            double time = MeasureSeconds([&] {
+                SuffixArray search(str, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Compact, n_threads);
+            });
+            std::cout << "\t" << n_threads << " threads " << time * 1000 << " ms";
         }
-
-        return classes;
+        std::cout << "\n";
     }
+}
 
-    std::vector<int> count_pair_sort(const std::vector<std::pair<int, int>>& pairs) const {
-        std::vector<int> cnt(n);
-        // сортируем по pair.second
-        for (int i = 0; i < n; ++i) {
-            ++cnt[pairs[i].second];
+// пачка запросов: цикл SearchRange против SearchBatch; половина шаблонов - подстроки текста длины от 4 до 64,
+// половина - их продолжения на 1-8 символов (часто встречаются, если шаблоны - слова с суффиксами)
+void BenchmarkBatch() {
+    std::mt19937 gen(7);
+    for (int n : {1 << 20, 8 << 20}) {
+        std::string str = NaturalText(gen, n);
+        SuffixArray search(str, SuffixArray::Builder::SAIS);
+        std::uniform_int_distribution<int> length(4, 64);
+        std::uniform_int_distribution<int> extension(1, 8);
+        std::uniform_int_distribution<int> position(0, n - 80);
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 50000; ++i) {
+            int start = position(gen);
+            int size = length(gen);
+            patterns.push_back(str.substr(start, size));
+            patterns.push_back(str.substr(start, size + extension(gen)));
         }
-        for (int i = 1; i < n; ++i) {
-            cnt[i] += cnt[i - 1];
+        std::shuffle(patterns.begin(), patterns.end(), gen);
+        size_t expected = 0;
+        double loop_time = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                expected += search.SearchRange(pattern).size();
+            }
+        });
+        std::cout << "N = " << (n >> 20) << "M, " << patterns.size() << " patterns:\tSearchRange loop "
+                  << patterns.size() / loop_time / 1e6 << " M q/s";
+        for (int n_threads : {1, 2, 4}) {
+            size_t found = 0;
+            double batch_time = MeasureSeconds([&] {
+                for (std::span<const int> range : search.SearchBatch(patterns, n_threads)) {
+                    found += range.size();
+                }
+            });
+            assert(found == expected);
+            std::cout << "\tbatch, " << n_threads << " threads " << patterns.size() / batch_time / 1e6 << " M q/s";
         }
+        std::cout << "\t(" << expected << " occurrences)\n";
+    }
+}
 
-        std::vector<int> p_second(n);
-        // p_second[k] = i означает, что на k месте в отсортированном списке по pair.second стоит pairs[i]
-        for (int i = n - 1; i >= 0; --i) {
-            p_second[--cnt[pairs[i].second]] = i;
-        }
-        std::vector<std::pair<int, int>> second_cnt_sort(n);
-        for (int i = 0; i < n; ++i) {
-            second_cnt_sort[i] = pairs[p_second[i]];
+// задержка одного запроса: pattern - случайные подстроки текста длины от 4 до 64
+void BenchmarkSearch() {
+    std::mt19937 gen(7);
+    const int n = 8 << 20;
+    std::string str = NaturalText(gen, n);
+    SuffixArray search(str, SuffixArray::Builder::SAIS);
+    std::vector<std::string> patterns;
+    std::uniform_int_distribution<int> length(4, 64);
+    std::uniform_int_distribution<int> position(0, n - 64);
+    for (int i = 0; i < 100000; ++i) {
+        patterns.push_back(str.substr(position(gen), length(gen)));
+    }
+    auto report = [&](const std::string& name, auto&& query) {
+        std::vector<double> latencies;
+        latencies.reserve(patterns.size());
+        size_t found = 0;
+        for (const std::string& pattern : patterns) {
+            latencies.push_back(MeasureSeconds([&] { found += query(pattern); }));
         }
+        std::sort(latencies.begin(), latencies.end());
+        double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+        std::cout << name << ":\tmean " << total / latencies.size() * 1e6 << " us\tp50 "
+                  << latencies[latencies.size() / 2] * 1e6 << " us\tp99 " << latencies[latencies.size() * 99 / 100] * 1e6
+                  << " us\t(" << found << " occurrences)\n";
+    };
+    report("Search     ", [&](const std::string& pattern) { return search.Search(pattern).size(); });
+    report("SearchRange", [&](const std::string& pattern) { return search.SearchRange(pattern).size(); });
+    std::vector<int> buffer(1 << 16);
+    report("Search sink", [&](const std::string& pattern) {
+        size_t count = 0;
+        search.Search(pattern, [&](int) {
+            ++count;
+            return true;
+        });
+        return count;
+    });
+    report("Search buf ", [&](const std::string& pattern) {
+        return search.Search(pattern, std::span<int>(buffer));
+    });
+    report("first match", [&](const std::string& pattern) {
+        return static_cast<size_t>(!search.Search(pattern, [](int) { return false; }));
+    });
+}
 
-        cnt.assign(n, 0);
-        // сортируем по pair.first
-        for (int i = 0; i < n; ++i) {
-            ++cnt[second_cnt_sort[i].first];
-        }
-        for (int i = 1; i < n; ++i) {
-            cnt[i] += cnt[i - 1];
+// размер FM-индекса и скорость запросов при разной частоте сэмплов суффиксного массива
+void BenchmarkFMIndex() {
+    std::mt19937 gen(7);
+    const int n = 8 << 20;
+    std::string str = NaturalText(gen, n);
+    SuffixArray search(str, SuffixArray::Builder::SAIS);
+    std::vector<std::string> patterns;
+    std::uniform_int_distribution<int> length(8, 32);
+    std::uniform_int_distribution<int> position(0, n - 32);
+    for (int i = 0; i < 20000; ++i) {
+        patterns.push_back(str.substr(position(gen), length(gen)));
+    }
+    size_t occurrences = 0;
+    double array_time = MeasureSeconds([&] {
+        for (const std::string& pattern : patterns) {
+            occurrences += search.Search(pattern).size();
         }
+    });
+    std::cout << "suffix array:\tsize " << static_cast<double>(search.MemoryBytes()) / n << " bytes/char\tSearch "
+              << array_time * 1e9 / occurrences << " ns/occurrence\n";
+    std::cout << "sample rate\tsize / text\tbits/char\tCount, us\tSearch, ns/occurrence\n";
+    for (int sample_rate : {4, 16, 32, 64, 128, 256}) {
+        FMIndex fm_index(search, sample_rate);
+        size_t counted = 0;
+        double count_time = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                counted += fm_index.Count(pattern);
+            }
+        });
+        size_t found = 0;
+        double search_time = MeasureSeconds([&] {
+            for (const std::string& pattern : patterns) {
+                found += fm_index.Search(pattern).size();
+            }
+        });
+        assert(counted == occurrences && found == occurrences);
+        std::cout << sample_rate << "\t\t" << static_cast<double>(fm_index.MemoryBytes()) / n << "\t\t"
+                  << static_cast<double>(fm_index.MemoryBytes()) * 8 / n << "\t\t"
+                  << count_time * 1e6 / patterns.size() << "\t\t" << search_time * 1e9 / occurrences << "\n";
+    }
+}
 
-        std::vector<int> p_first(n);
-        // p_first[k] = i означает, что на k месте в отсортированном списке стоит second_cnt_sort[i]
-        for (int i = n - 1; i >= 0; --i) {
-            p_first[--cnt[second_cnt_sort[i].first]] = i;
-        }
-        // композиция двух перемещений
-        std::vector<int> p(n);
-        for (int i = 0; i < n; ++i) {
-            p[i] = p_second[p_first[i]];
-        }
-        std::vector<int> classes(n);
-        int curr_class = 0;
-        classes[p[0]] = 0;
-        for (int i = 1; i < n; ++i) {
-            if (pairs[p[i]] != pairs[p[i - 1]]) {
-                ++curr_class;
+// пиковая память построения: каждый вариант строится в отдельном процессе, ru_maxrss которого не зависит от остальных
+void BenchmarkMemory() {
+    for (int n : {4 << 20, 8 << 20}) {
+        std::vector<std::pair<std::string, std::pair<SuffixArray::Builder, SuffixArray::Layout>>> variants = {
+                {"doubling, levels ", {SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels}},
+                {"doubling, compact", {SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Compact}},
+                {"SA-IS, compact   ", {SuffixArray::Builder::SAIS, SuffixArray::Layout::Compact}},
+        };
+        for (const auto&[name, variant] : variants) {
+            std::cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                std::mt19937 gen(7);
+                std::string str = NaturalText(gen, n);
+                rusage usage{};
+                getrusage(RUSAGE_SELF, &usage);
+                long rss_before = usage.ru_maxrss;
+                SuffixArray search(str, variant.first, variant.second);
+                getrusage(RUSAGE_SELF, &usage);
+                std::cout << name << " N = " << (n >> 20) << "M:\tpeak RSS " << (usage.ru_maxrss - rss_before) / 1024
+                          << " MB\tindex " << (search.MemoryBytes() >> 20) << " MB\n";
+                std::cout.flush();
+                _exit(0);
             }
-            classes[p[i]] = curr_class;
+            waitpid(pid, nullptr, 0);
         }
-        return classes;
     }
+}
 
-    static std::vector<int> powers_of_2(int max_number) {
-        std::vector<int> powers = {1};
-        while (powers.back() * 2 < max_number) {
-            powers.push_back(powers.back() * 2);
-        }
-        return powers;
+// время до первого ответа: построение индекса с нуля против отображения сохраненного файла
+void BenchmarkStartup() {
+    std::mt19937 gen(7);
+    std::string path = (std::filesystem::temp_directory_path() / "suffix_array_bench.idx").string();
+    for (int n : {1 << 20, 8 << 20}) {
+        std::string str = NaturalText(gen, n);
+        std::string pattern = str.substr(n / 2, 16);
+        size_t found = 0;
+        double build_time = MeasureSeconds([&] {
+            SuffixArray search(str, SuffixArray::Builder::SAIS);
+            found += search.SearchRange(pattern).size();
+        });
+        SuffixArray(str, SuffixArray::Builder::SAIS).Save(path);
+        double load_time = MeasureSeconds([&] {
+            SuffixArray search = SuffixArray::Load(path);
+            found -= search.SearchRange(pattern).size();
+        });
+        assert(found == 0);
+        std::cout << "N = " << (n >> 20) << "M:	build + query " << build_time * 1000 << " ms	load + query "
+                  << load_time * 1000 << " ms	file " << (std::filesystem::file_size(path) >> 20) << " MB\n";
     }
-};
+    std::filesystem::remove(path);
+}
 
 void PrintLine(int n = 20) {
     for (int i = 0; i < n; ++i) {
@@ -281,10 +511,302 @@ void MakeExampleRegularSearch(const std::string& str, const std::vector<std::str
     PrintLine();
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        BenchmarkSearch();
+        BenchmarkBatch();
+        BenchmarkFMIndex();
+        BenchmarkMemory();
+        BenchmarkConstruction();
+        BenchmarkParallelConstruction();
+        BenchmarkStartup();
+        BenchmarkAlphabet();
+        BenchmarkWildcard();
+        BenchmarkApproximate();
+        BenchmarkDocuments();
+        BenchmarkRepeats();
+        return 0;
+    }
+    {
+        // счетчики одного запроса; без STRING_SEARCH_STATS они нулевые
+        SuffixArray search("abracadabra");
+        stats::Scope scope;
+        bool found = search.SearchRange("abra").size() == 2;
+        stats::Snapshot delta = scope.Delta();
+        assert(found);
+        if constexpr (stats::ENABLED) {
+            assert(delta.Calls(stats::Timer::SuffixArrayBound) == 2 && delta[stats::Counter::SuffixArrayProbes] > 0);
+            assert(delta[stats::Counter::SuffixArrayByteComparisons] >= 8);
+            assert(stats::Total()[stats::Counter::SuffixArrayProbes] >= delta[stats::Counter::SuffixArrayProbes]);
+        } else {
+            assert(delta[stats::Counter::SuffixArrayProbes] == 0);
+        }
+        assert(delta.ToJson().find("\"suffix_array_probes\": ") != std::string::npos);
+    }
+    {
+        // SA-IS строит тот же массив, что и удвоение префиксов
+        std::mt19937 gen(1);
+        for (int t = 0; t < 300; ++t) {
+            std::string s = t % 3 == 0 ? FibonacciString(t) : RandomString(gen, t, 1 + t % 4);
+            SuffixArray doubling(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels);
+            SuffixArray compact(s);
+            SuffixArray sais(s, SuffixArray::Builder::SAIS);
+            assert(doubling.suffix_array.back() == sais.suffix_array.back());
+            assert(compact.suffix_array.size() == 1 && compact.suffix_array.back() == sais.suffix_array.back());
+            assert(doubling.lcp == sais.lcp && compact.lcp == sais.lcp);
+            for (int i = 1; i < sais.n; ++i) {
+                int a = sais.suffix_array.back()[i - 1];
+                int b = sais.suffix_array.back()[i];
+                int common = 0;
+                while (sais.str[a + common] == sais.str[b + common]) {
+                    ++common;
+                }
+                assert(sais.lcp[i] == common);
+            }
+        }
+    }
+    {
+        // параллельное удвоение префиксов строит те же массивы на всех уровнях, что и последовательное
+        std::mt19937 gen(11);
+        for (int t = 0; t < 200; ++t) {
+            std::string s = t % 3 == 0 ? FibonacciString(t * 7) : RandomString(gen, t * 7, 1 + t % 4);
+            SuffixArray sequential(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels);
+            for (int n_threads : {2, 3, 4}) {
+                SuffixArray levels(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels, n_threads);
+                SuffixArray compact(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Compact, n_threads);
+                assert(levels.suffix_array == sequential.suffix_array && levels.lcp == sequential.lcp);
+                assert(compact.suffix_array.back() == sequential.suffix_array.back());
+            }
+        }
+    }
+    {
+        // SearchBatch отвечает на пачку так же, как SearchRange на каждый шаблон: пачки с повторами,
+        // шаблонами-префиксами друг друга, пустым шаблоном и отсутствующими байтами
+        std::mt19937 gen(12);
+        for (int t = 0; t < 200; ++t) {
+            std::string s = t % 4 == 0 ? FibonacciString(t * 5) : RandomString(gen, t * 5, 1 + t % 3);
+            SuffixArray search(s, t % 2 == 0 ? SuffixArray::Builder::SAIS : SuffixArray::Builder::PrefixDoubling);
+            std::vector<std::string> patterns;
+            for (int q = 0; q < 3 * t; ++q) {
+                if (q % 7 == 3 && !patterns.empty()) {
+                    patterns.push_back(patterns[q / 2]);
+                } else if (q % 5 == 1 && !s.empty()) {
+                    patterns.push_back(s.substr(q % s.size(), 1 + q % 6));
+                } else {
+                    patterns.push_back(RandomString(gen, q % 6, 1 + t % 4));
+                }
+            }
+            for (int n_threads : {1, 2, 3}) {
+                std::vector<std::span<const int>> batch = search.SearchBatch(patterns, n_threads);
+                assert(batch.size() == patterns.size());
+                for (size_t q = 0; q < patterns.size(); ++q) {
+                    std::span<const int> expected = search.SearchRange(patterns[q]);
+                    assert(batch[q].data() == expected.data() && batch[q].size() == expected.size());
+                }
+            }
+        }
+    }
+    {
+        // Search находит ровно те позиции, что и проверка каждой позиции
+        std::mt19937 gen(2);
+        for (int t = 0; t < 300; ++t) {
+            std::string s = RandomString(gen, t, 1 + t % 3);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = RandomString(gen, 1 + q % 5, 1 + t % 4);
+                std::vector<int> expected;
+                for (size_t pos = 0; pos + pattern.size() <= s.size(); ++pos) {
+                    if (s.compare(pos, pattern.size(), pattern) == 0) {
+                        expected.push_back(pos);
+                    }
+                }
+                std::vector<int> found = search.Search(pattern);
+                // sink и буфер видят позиции в том же порядке, что и векторный интерфейс
+                std::vector<int> sunk;
+                bool finished = search.Search(pattern, [&](int pos) {
+                    sunk.push_back(pos);
+                    return true;
+                });
+                assert(finished && sunk == found);
+                int stops = 0;
+                finished = search.Search(pattern, [&](int) { return ++stops < 2; });
+                assert(finished == (found.size() < 2));
+                assert(stops == static_cast<int>(std::min<size_t>(found.size(), 2)));
+                std::vector<int> buffer(q % 4);
+                size_t written = search.Search(pattern, std::span<int>(buffer));
+                assert(written == std::min(buffer.size(), found.size()));
+                assert(std::equal(buffer.begin(), buffer.begin() + written, found.begin()));
+                std::sort(found.begin(), found.end());
+                assert(found == expected);
+            }
+        }
+    }
+    {
+        // '?'-поиск совпадает с проверкой каждой позиции, в том числе для подряд идущих и крайних '?'
+        std::mt19937 gen(3);
+        for (int t = 0; t < 300; ++t) {
+            std::string s = RandomString(gen, t, 1 + t % 3);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = RandomString(gen, q % 7, 1 + t % 4);
+                for (char& c : pattern) {
+                    if (gen() % 3 == 0) {
+                        c = '?';
+                    }
+                }
+                std::vector<int> expected;
+                for (size_t pos = 0; pos + pattern.size() <= s.size(); ++pos) {
+                    bool matches = true;
+                    for (size_t j = 0; j < pattern.size(); ++j) {
+                        matches &= pattern[j] == '?' || pattern[j] == s[pos + j];
+                    }
+                    if (matches) {
+                        expected.push_back(pos);
+                    }
+                }
+                assert(search.RegularSearch(pattern) == expected);
+                assert(search.ShiftAndSearch(pattern) == expected);
+            }
+        }
+    }
+    {
+        // поиск с k несовпадениями и k правками совпадает с проверкой каждой позиции
+        std::mt19937 gen(4);
+        for (int t = 0; t < 200; ++t) {
+            std::string s = RandomString(gen, t, 2 + t % 3);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            for (int q = 0; q < 10; ++q) {
+                std::string pattern = RandomString(gen, q % 8, 2 + t % 3);
+                int k = q % 4;
+                std::vector<int> hamming;
+                std::vector<int> edit;
+                for (int start = 0; start <= static_cast<int>(s.size()); ++start) {
+                    if (start + pattern.size() <= s.size()) {
+                        int mismatches = 0;
+                        for (size_t j = 0; j < pattern.size(); ++j) {
+                            mismatches += pattern[j] != s[start + j];
+                        }
+                        if (mismatches <= k) {
+                            hamming.push_back(start);
+                        }
+                    }
+                    // расстояние от pattern до s[start..end) для всех end полной таблицей
+                    int width = s.size() - start;
+                    std::vector<std::vector<int>> table(pattern.size() + 1, std::vector<int>(width + 1));
+                    for (size_t i = 0; i <= pattern.size(); ++i) {
+                        for (int j = 0; j <= width; ++j) {
+                            if (i == 0 || j == 0) {
+                                table[i][j] = i + j;
+                            } else {
+                                table[i][j] = std::min({table[i - 1][j] + 1, table[i][j - 1] + 1,
+                                                        table[i - 1][j - 1] + (pattern[i - 1] != s[start + j - 1])});
+                            }
+                        }
+                    }
+                    if (*std::min_element(table.back().begin(), table.back().end()) <= k) {
+                        edit.push_back(start);
+                    }
+                }
+                assert(search.HammingSearch(pattern, k) == hamming);
+                assert(search.EditSearch(pattern, k) == edit);
+            }
+        }
+    }
+    {
+        // FM-индекс отвечает так же, как суффиксный массив, при любой частоте сэмплов
+        std::mt19937 gen(3);
+        for (int t = 0; t < 200; ++t) {
+            std::string s = t % 5 == 0 ? FibonacciString(t) : RandomString(gen, t, 1 + t % 4);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            FMIndex fm_index(search, 1 + t % 7);
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = RandomString(gen, q % 6, 1 + t % 5);
+                assert(fm_index.Search(pattern) == search.Search(pattern));
+                assert(fm_index.Count(pattern) == static_cast<int>(search.SearchRange(pattern).size()) ||
+                       pattern.empty());
+            }
+        }
+    }
+    {
+        // произвольные байты, в том числе байт сентинела '\0' и байты старше 127
+        std::mt19937 gen(5);
+        const std::string bytes = {'\0', '\x01', '\x7f', '\x80', '\xff', 'a', '{'};
+        auto random_bytes = [&](int size, int alphabet_size) {
+            std::uniform_int_distribution<int> byte(0, alphabet_size - 1);
+            std::string str(size, '\0');
+            for (char& c : str) {
+                c = bytes[byte(gen)];
+            }
+            return str;
+        };
+        for (int t = 0; t < 200; ++t) {
+            std::string s = random_bytes(t, 1 + t % bytes.size());
+            SuffixArray doubling(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels);
+            SuffixArray sais(s, SuffixArray::Builder::SAIS);
+            std::vector<int> expected(s.size() + 1);
+            std::iota(expected.begin(), expected.end(), 0);
+            // сентинел больше любого байта: его суффикс последний, а префикс другого суффикса стоит после него
+            std::sort(expected.begin(), expected.end(), [&](int a, int b) {
+                std::string_view x = std::string_view(s).substr(a);
+                std::string_view y = std::string_view(s).substr(b);
+                size_t common = std::mismatch(x.begin(), x.end(), y.begin(), y.end()).first - x.begin();
+                if (common == x.size() || common == y.size()) {
+                    return x.size() > y.size();
+                }
+                return static_cast<unsigned char>(x[common]) < static_cast<unsigned char>(y[common]);
+            });
+            assert(doubling.suffix_array.back() == expected && sais.suffix_array.back() == expected);
+            assert(doubling.lcp == sais.lcp);
+            FMIndex fm_index(sais, 1 + t % 5);
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = random_bytes(1 + q % 4, bytes.size());
+                std::vector<int> found;
+                for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1)) {
+                    found.push_back(pos);
+                }
+                std::vector<int> search = sais.Search(pattern);
+                assert(fm_index.Search(pattern) == search);
+                std::sort(search.begin(), search.end());
+                assert(search == found);
+            }
+        }
+    }
+    {
+        // индекс, сохраненный в файл и отображенный обратно, отвечает так же, как построенный
+        // номер процесса в имени: обычная и _stats сборки примера под ctest -j идут одновременно
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("suffix_array_test." + std::to_string(getpid()) + ".idx")).string();
+        std::mt19937 gen(4);
+        for (int t = 0; t < 50; ++t) {
+            std::string s = RandomString(gen, t, 1 + t % 4);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            search.Save(path);
+            SuffixArray loaded = SuffixArray::Load(path);
+            assert(loaded.Text() == search.Text());
+            assert(std::ranges::equal(loaded.Array(), search.Array()));
+            assert(std::ranges::equal(loaded.LCP(), search.LCP()));
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = RandomString(gen, q % 5, 1 + t % 4);
+                assert(loaded.Search(pattern) == search.Search(pattern));
+            }
+        }
+        // испорченный заголовок не принимается
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.write("XXXX", 4);
+        }
+        bool rejected = false;
+        try {
+            SuffixArray::Load(path);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+        std::filesystem::remove(path);
+    }
     {
         std::string s = "aaba";
-        SuffixArray search(s);
+        SuffixArray search(s, SuffixArray::Builder::PrefixDoubling, SuffixArray::Layout::Levels);
         std::cout << "Simple search:\n";
         std::cout << "string: " << s << "\n";
         std::cout << "suffix_array:" << "\n";
@@ -315,5 +837,120 @@ int main() {
     MakeExampleRegularSearch("abracadabra", {"a?a"});
     MakeExampleRegularSearch("abracadabra", {"a?r", "a??b", "a?r?"});
 
+    {
+        // минимум на отрезке совпадает с перебором
+        std::mt19937 gen(6);
+        for (int size : {1, 31, 32, 33, 100, 1000}) {
+            std::vector<int> values(size);
+            for (int& value : values) {
+                value = gen() % 10 - 1;
+            }
+            RangeMinimum minimum(values);
+            for (int q = 0; q < 500; ++q) {
+                int left = gen() % size;
+                int right = left + 1 + gen() % (size - left);
+                assert(minimum.ArgMin(left, right) == std::min_element(values.begin() + left, values.begin() + right) -
+                                                      values.begin());
+            }
+        }
+    }
+    {
+        // обобщенный суффиксный массив: вхождения и список документов совпадают с поиском в каждом документе
+        std::mt19937 gen(7);
+        for (int t = 0; t < 100; ++t) {
+            std::vector<std::string> documents(1 + t % 20);
+            for (std::string& document : documents) {
+                document = RandomString(gen, gen() % 12, 1 + t % 3);
+            }
+            if (t % 10 == 0) {
+                // все 256 байтов заняты: разделитель совпадает с байтом документа
+                for (int c = 0; c < 256; ++c) {
+                    documents[0] += static_cast<char>(c);
+                }
+                documents.push_back(std::string(1, '\xff') + "a");
+            }
+            DocumentIndex index(documents);
+            for (int q = 0; q < 30; ++q) {
+                std::string pattern = RandomString(gen, 1 + q % 4, 1 + t % 3);
+                if (q % 5 == 0) {
+                    pattern = std::string(1, '\xff') + pattern;
+                }
+                std::vector<DocumentIndex::Occurrence> expected;
+                std::vector<int> expected_documents;
+                for (size_t d = 0; d < documents.size(); ++d) {
+                    for (size_t pos = documents[d].find(pattern); pos != std::string::npos;
+                         pos = documents[d].find(pattern, pos + 1)) {
+                        expected.push_back({static_cast<int>(d), static_cast<int>(pos)});
+                    }
+                    if (documents[d].find(pattern) != std::string::npos) {
+                        expected_documents.push_back(d);
+                    }
+                }
+                assert(index.Locate(pattern) == expected);
+                assert(index.ListDocuments(pattern) == expected_documents);
+            }
+        }
+    }
+
+    {
+        // анализ повторов совпадает с перебором всех подстрок
+        std::mt19937 gen(8);
+        for (int t = 0; t < 200; ++t) {
+            std::string s = t % 7 == 0 ? FibonacciString(t) : RandomString(gen, t, 1 + t % 4);
+            SuffixArray search(s, SuffixArray::Builder::SAIS);
+            std::map<std::string, std::vector<int>> occurrences;
+            for (size_t begin = 0; begin < s.size(); ++begin) {
+                for (size_t length = 1; begin + length <= s.size(); ++length) {
+                    occurrences[s.substr(begin, length)].push_back(begin);
+                }
+            }
+            assert(search.DistinctSubstrings() == static_cast<int64_t>(occurrences.size()));
+            int longest = 0;
+            int min_length = 1 + t % 3;
+            std::vector<SuffixArray::Repeat> expected;
+            for (const auto&[substring, positions] : occurrences) {
+                int length = substring.size();
+                if (positions.size() < 2) {
+                    continue;
+                }
+                longest = std::max(longest, length);
+                // символы до и после вхождений, -1 - начало или конец строки
+                std::set<int> before;
+                std::set<int> after;
+                for (int pos : positions) {
+                    before.insert(pos == 0 ? -1 : s[pos - 1]);
+                    after.insert(pos + length == static_cast<int>(s.size()) ? -1 : s[pos + length]);
+                }
+                bool left_maximal = before.size() > 1 || before.count(-1);
+                bool right_maximal = after.size() > 1 || after.count(-1);
+                if (left_maximal && right_maximal && length >= min_length) {
+                    expected.push_back({positions[0], length, static_cast<int>(positions.size())});
+                }
+            }
+            std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+                return a.position != b.position ? a.position < b.position : a.length < b.length;
+            });
+            assert(search.MaximalRepeats(min_length) == expected);
+            SuffixArray::Repeat repeat = search.LongestRepeatedSubstring();
+            assert(repeat.length == longest);
+            if (longest > 0) {
+                const std::vector<int>& positions = occurrences[s.substr(repeat.position, repeat.length)];
+                assert(positions[0] == repeat.position && static_cast<int>(positions.size()) == repeat.count);
+            }
+            std::string other = RandomString(gen, t % 13, 1 + t % 4);
+            int common = 0;
+            for (size_t begin = 0; begin < other.size(); ++begin) {
+                for (size_t length = 1; begin + length <= other.size(); ++length) {
+                    if (occurrences.count(other.substr(begin, length))) {
+                        common = std::max(common, static_cast<int>(length));
+                    }
+                }
+            }
+            SuffixArray::CommonSubstring lcs = SuffixArray::LongestCommonSubstring(s, other);
+            assert(lcs.length == common);
+            assert(s.substr(lcs.first_position, lcs.length) == other.substr(lcs.second_position, lcs.length));
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,1664 @@
+#pragma once
+
+#include "index_file.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class SuffixArray {
+public:
+    enum class Builder {
+        // удвоение префиксов, O(N log N), сохраняет массив для каждой степени двойки
+        PrefixDoubling,
+        // SA-IS (induced sorting), O(N), строит только итоговый массив
+        SAIS,
+    };
+
+    enum class Layout {
+        // массив для каждой степени двойки, O(N log N) памяти (уровни есть только при удвоении префиксов)
+        Levels,
+        // только итоговый суффиксный массив и массив LCP, O(N) памяти
+        Compact,
+    };
+
+    // текст и сентинел в конце; сентинел - виртуальный символ больше любого байта,
+    // байт SENTINEL в str хранится только для выравнивания длин и ни с чем не сравнивается
+    std::string str;
+    int n;
+    std::vector<int> powers;
+    // suffix_array[i] - суффиксы, отсортированные по первым powers[i] символам, последний массив отсортирован полностью
+    std::vector<std::vector<int>> suffix_array;
+    int k;
+    // lcp[i] - длина общего префикса суффиксов suffix_array.back()[i - 1] и suffix_array.back()[i], lcp[0] = 0
+    std::vector<int> lcp;
+    // LCP середин двоичного поиска с границами, см. MakeLCPLR
+    std::vector<int> lcp_lr;
+
+private:
+    // индекс, загруженный из файла: поля выше пустые, запросы читают отображенную память
+    std::shared_ptr<const index_file::MappedFile> mapping;
+    std::string_view mapped_text;
+    std::span<const int> mapped_array;
+    std::span<const int> mapped_lcp;
+    std::span<const int> mapped_lcp_lr;
+
+    // разделы файла индекса
+    static constexpr uint32_t TEXT_SECTION = 1;
+    static constexpr uint32_t ARRAY_SECTION = 2;
+    static constexpr uint32_t LCP_SECTION = 3;
+    static constexpr uint32_t LCP_LR_SECTION = 4;
+
+    // RegularSearch сканирует текст Shift-And, когда кандидатов больше чем (длина текста) / SHIFT_AND_RATIO:
+    // проверка кандидата - промах кэша (~100 нс), а Shift-And тратит ~1 нс на символ
+    static constexpr int SHIFT_AND_MAX_LENGTH = 64;
+    static constexpr size_t SHIFT_AND_RATIO = 64;
+
+    // цифра параллельной поразрядной сортировки: гистограмма 2^11 счетчиков на поток помещается в L1
+    static constexpr int RADIX_BITS = 11;
+
+    // SearchBatch ведет столько двоичных поисков вперемешку: пока один ждет память, остальные считаются
+    static constexpr int BATCH_LANES = 16;
+
+    // одна часть пачки SearchBatch: шаблоны order[next..end) ищутся по очереди, поиск текущей границы -
+    // отрезок (left, right) массива, l и r - общие префиксы с его концами, known - длина префикса, общего у pattern
+    // со всеми суффиксами отрезка; middle - строка, данные которой подгружаются к следующему шагу (-1 - часть пуста)
+    struct BatchLane {
+        size_t next;
+        size_t end;
+        int query = -1;
+        bool upper = false;
+        int left = 0;
+        int right = 0;
+        int l = 0;
+        int r = 0;
+        int known = 0;
+        int middle = -1;
+        int position = 0;
+        int found_left = 0;
+        int previous_left = 0;
+        // уже найденные шаблоны, каждый - префикс следующего: (номер шаблона, left, right)
+        std::vector<std::tuple<int, int, int>> prefixes;
+    };
+
+    SuffixArray() : n(0), k(0) {}
+
+public:
+    static constexpr char SENTINEL = '\0';
+
+    // n_threads - число потоков удвоения префиксов (1 - последовательная сортировка подсчетом), SA-IS однопоточный
+    explicit SuffixArray(const std::string& input_str, Builder builder = Builder::PrefixDoubling,
+                         Layout layout = Layout::Compact, int n_threads = 1)
+            : str(input_str + SENTINEL),
+              n(str.size()),
+              powers(powers_of_2(n)),
+              suffix_array(powers.size()),
+              k(suffix_array.size()) {
+        stats::ScopedTimer timer(stats::Timer::SuffixArrayBuild);
+        if (builder == Builder::SAIS) {
+            MakeSuffixArraySAIS();
+        } else {
+            MakeSuffixArray(layout, n_threads);
+        }
+        MakeLCP();
+        MakeLCPLR();
+    }
+
+    void MakeSuffixArray(Layout layout, int n_threads) {
+        // в компактном режиме храним только классы текущего уровня
+        std::vector<int> classes = count_sort();
+        if (layout == Layout::Levels) {
+            suffix_array[0] = classes;
+        }
+        for (int i = 1; i < k; ++i) {
+            if (n_threads > 1) {
+                classes = parallel_pair_sort(classes, powers[i - 1], n_threads);
+            } else {
+                std::vector<std::pair<int, int>> pairs(n);
+                for (int j = 0; j < n; ++j) {
+                    pairs[j] = {classes[j], classes[(j + powers[i - 1]) % n]};
+                }
+                classes = count_pair_sort(pairs);
+            }
+            if (layout == Layout::Levels) {
+                suffix_array[i] = classes;
+            }
+        }
+        if (layout == Layout::Compact) {
+            powers = {powers.back()};
+            suffix_array = {std::move(classes)};
+            k = 1;
+        }
+        for (std::vector<int>& array : suffix_array) {
+            std::vector<int> cnt(n);
+            for (int c : array) {
+                ++cnt[c];
+            }
+            for (int i = 1; i < n; ++i) {
+                cnt[i] += cnt[i - 1];
+            }
+            std::vector<int> p(n);
+            for (int i = n - 1; i >= 0; --i) {
+                p[--cnt[array[i]]] = i;
+            }
+            array = p;
+        }
+    }
+
+    void MakeSuffixArraySAIS() {
+        // символы -> 1..sigma, сентинел остается наибольшим,
+        // в конец дописываем наименьший символ 0, который нужен SA-IS и не меняет порядок остальных суффиксов
+        std::vector<int> s;
+        int alphabet_size = RemapAlphabet(s);
+        for (int& c : s) {
+            ++c;
+        }
+        s.push_back(0);
+        std::vector<int> array = sa_is(s, alphabet_size + 1);
+        array.erase(array.begin());
+        powers = {powers.back()};
+        suffix_array = {std::move(array)};
+        k = 1;
+    }
+
+    // алгоритм Касаи: LCP суффикса i не меньше LCP суффикса i - 1 минус один, O(N)
+    void MakeLCP() {
+        const std::vector<int>& array = suffix_array.back();
+        std::vector<int> rank(n);
+        for (int i = 0; i < n; ++i) {
+            rank[array[i]] = i;
+        }
+        lcp.assign(n, 0);
+        int common = 0;
+        for (int i = 0; i < n; ++i) {
+            if (rank[i] == 0) {
+                common = 0;
+                continue;
+            }
+            int j = array[rank[i] - 1];
+            // сентинел (позиция n - 1) ни с чем не совпадает
+            while (i + common < n - 1 && j + common < n - 1 && str[i + common] == str[j + common]) {
+                ++common;
+            }
+            lcp[rank[i]] = common;
+            if (common > 0) {
+                --common;
+            }
+        }
+    }
+
+    // для каждой середины двоичного поиска по [0, n - 1] - LCP с левой и с правой границей отрезка,
+    // lcp_lr[2 * middle] и lcp_lr[2 * middle + 1]
+    void MakeLCPLR() {
+        lcp_lr.assign(2 * n, 0);
+        if (n > 1) {
+            MakeLCPLR(0, n - 1);
+        }
+    }
+
+    // возвращает LCP суффиксов на границах отрезка - минимум lcp[left + 1..right]
+    int MakeLCPLR(int left, int right) {
+        if (left + 1 == right) {
+            return lcp[right];
+        }
+        int middle = left + (right - left) / 2;
+        lcp_lr[2 * middle] = MakeLCPLR(left, middle);
+        lcp_lr[2 * middle + 1] = MakeLCPLR(middle, right);
+        return std::min(lcp_lr[2 * middle], lcp_lr[2 * middle + 1]);
+    }
+
+    // текст с сентинелом, итоговый суффиксный массив и LCP - из построенного индекса или из файла
+    [[nodiscard]] std::string_view Text() const {
+        return mapping ? mapped_text : std::string_view(str);
+    }
+
+    [[nodiscard]] std::span<const int> Array() const {
+        return mapping ? mapped_array : std::span<const int>(suffix_array.back());
+    }
+
+    [[nodiscard]] std::span<const int> LCP() const {
+        return mapping ? mapped_lcp : std::span<const int>(lcp);
+    }
+
+    [[nodiscard]] std::span<const int> LCPLR() const {
+        return mapping ? mapped_lcp_lr : std::span<const int>(lcp_lr);
+    }
+
+    // сохраняет текст, суффиксный массив, LCP и LCP середин в файл индекса
+    void Save(const std::string& path) const {
+        index_file::Writer writer(index_file::Kind::SuffixArray);
+        writer.AddSection(TEXT_SECTION, Text());
+        writer.AddSection(ARRAY_SECTION, Array());
+        writer.AddSection(LCP_SECTION, LCP());
+        writer.AddSection(LCP_LR_SECTION, LCPLR());
+        writer.Write(path);
+    }
+
+    // отображает файл индекса в память: запросы работают сразу, без построения и копирования;
+    // уровней удвоения у загруженного индекса нет (k = 0)
+    static SuffixArray Load(const std::string& path) {
+        SuffixArray index;
+        index.mapping = std::make_shared<const index_file::MappedFile>(path, index_file::Kind::SuffixArray);
+        index.mapped_text = index.mapping->Bytes(TEXT_SECTION);
+        index.mapped_array = index.mapping->Section<int>(ARRAY_SECTION);
+        index.mapped_lcp = index.mapping->Section<int>(LCP_SECTION);
+        index.mapped_lcp_lr = index.mapping->Section<int>(LCP_LR_SECTION);
+        index.n = index.mapped_text.size();
+        if (index.n == 0 || index.mapped_array.size() != index.mapped_text.size() ||
+            index.mapped_lcp.size() != index.mapped_text.size() ||
+            index.mapped_lcp_lr.size() != 2 * index.mapped_text.size()) {
+            throw std::runtime_error(path + ": inconsistent suffix array sections");
+        }
+        return index;
+    }
+
+    // память, которую занимает индекс после построения
+    [[nodiscard]] size_t MemoryBytes() const {
+        size_t bytes = str.capacity() + (lcp.capacity() + lcp_lr.capacity()) * sizeof(int);
+        for (const std::vector<int>& array : suffix_array) {
+            bytes += array.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    // суффиксный массив строки s над алфавитом [0, alphabet_size), s.back() == 0 - единственный наименьший символ
+    static std::vector<int> sa_is(const std::vector<int>& s, int alphabet_size) {
+        int len = s.size();
+        std::vector<int> sa(len, -1);
+        if (len == 1) {
+            sa[0] = 0;
+            return sa;
+        }
+        // is_s[i]: суффикс i меньше суффикса i + 1 (S-тип), иначе L-тип
+        std::vector<bool> is_s(len);
+        is_s[len - 1] = true;
+        for (int i = len - 2; i >= 0; --i) {
+            is_s[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && is_s[i + 1]);
+        }
+        auto is_lms = [&](int i) {
+            return i > 0 && is_s[i] && !is_s[i - 1];
+        };
+        std::vector<int> bucket_begin(alphabet_size + 1);
+        for (int c : s) {
+            ++bucket_begin[c + 1];
+        }
+        for (int c = 1; c <= alphabet_size; ++c) {
+            bucket_begin[c] += bucket_begin[c - 1];
+        }
+        std::vector<int> bucket(alphabet_size);
+        // индуцированная сортировка: LMS-суффиксы в концы корзин, затем L-суффиксы слева направо, S-суффиксы справа налево
+        auto induce = [&](const std::vector<int>& lms) {
+            sa.assign(len, -1);
+            std::copy(bucket_begin.begin() + 1, bucket_begin.end(), bucket.begin());
+            for (int i = static_cast<int>(lms.size()) - 1; i >= 0; --i) {
+                sa[--bucket[s[lms[i]]]] = lms[i];
+            }
+            std::copy(bucket_begin.begin(), bucket_begin.end() - 1, bucket.begin());
+            for (int i = 0; i < len; ++i) {
+                int j = sa[i] - 1;
+                if (j >= 0 && !is_s[j]) {
+                    sa[bucket[s[j]]++] = j;
+                }
+            }
+            std::copy(bucket_begin.begin() + 1, bucket_begin.end(), bucket.begin());
+            for (int i = len - 1; i >= 0; --i) {
+                int j = sa[i] - 1;
+                if (j >= 0 && is_s[j]) {
+                    sa[--bucket[s[j]]] = j;
+                }
+            }
+        };
+
+        std::vector<int> lms;
+        for (int i = 1; i < len; ++i) {
+            if (is_lms(i)) {
+                lms.push_back(i);
+            }
+        }
+        induce(lms);
+
+        // после индуцированной сортировки LMS-подстроки упорядочены, даем им имена
+        auto lms_equal = [&](int a, int b) {
+            for (int j = 0;; ++j) {
+                if (s[a + j] != s[b + j] || is_s[a + j] != is_s[b + j]) {
+                    return false;
+                }
+                if (j > 0 && (is_lms(a + j) || is_lms(b + j))) {
+                    return is_lms(a + j) && is_lms(b + j);
+                }
+            }
+        };
+        std::vector<int> name(len, -1);
+        int n_names = 0;
+        int prev = -1;
+        for (int i = 0; i < len; ++i) {
+            if (!is_lms(sa[i])) {
+                continue;
+            }
+            if (prev == -1 || !lms_equal(prev, sa[i])) {
+                ++n_names;
+            }
+            name[sa[i]] = n_names - 1;
+            prev = sa[i];
+        }
+        // сокращенная строка из имен LMS-подстрок в порядке текста, ее последний символ - сентинел с именем 0
+        std::vector<int> reduced;
+        reduced.reserve(lms.size());
+        for (int i : lms) {
+            reduced.push_back(name[i]);
+        }
+        std::vector<int> reduced_sa;
+        if (n_names < static_cast<int>(reduced.size())) {
+            reduced_sa = sa_is(reduced, n_names);
+        } else {
+            reduced_sa.resize(reduced.size());
+            for (int i = 0; i < static_cast<int>(reduced.size()); ++i) {
+                reduced_sa[reduced[i]] = i;
+            }
+        }
+        // LMS-суффиксы в правильном порядке индуцируют порядок всех суффиксов
+        std::vector<int> sorted_lms;
+        sorted_lms.reserve(lms.size());
+        for (int i : reduced_sa) {
+            sorted_lms.push_back(lms[i]);
+        }
+        induce(sorted_lms);
+        return sa;
+    }
+
+    std::vector<int> Search(const std::string& pattern) const {
+        if (pattern.empty()) {
+            std::vector<int> ans(n);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        std::span<const int> found = SearchRange(pattern);
+        return {found.begin(), found.end()};
+    }
+
+    // позиции вхождений по одному, без выделения памяти; если sink(position) вернул false,
+    // перебор останавливается и Search возвращает false
+    template <class Sink>
+    bool Search(const std::string& pattern, Sink&& sink) const {
+        if (pattern.empty()) {
+            for (int i = 0; i < n; ++i) {
+                if (!sink(i)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        for (int pos : SearchRange(pattern)) {
+            if (!sink(pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // пишет позиции в заранее выделенный буфер, пока он не заполнится; возвращает число записанных позиций
+    size_t Search(const std::string& pattern, std::span<int> buffer) const {
+        if (pattern.empty()) {
+            size_t size = std::min<size_t>(buffer.size(), n);
+            std::iota(buffer.begin(), buffer.begin() + size, 0);
+            return size;
+        }
+        std::span<const int> found = SearchRange(pattern);
+        size_t size = std::min(buffer.size(), found.size());
+        std::copy_n(found.begin(), size, buffer.begin());
+        return size;
+    }
+
+    // вхождения pattern - отрезок [left_bound, right_bound) суффиксного массива, позиции не копируются
+    std::span<const int> SearchRange(const std::string& pattern) const {
+        int left = left_bound(pattern);
+        int right = right_bound(pattern);
+        return Array().subspan(left, right - left);
+    }
+
+    // то же, что SearchRange для каждого шаблона пачки: ans[i] - вхождения patterns[i].
+    // Шаблоны сортируются, поэтому левая граница следующего не меньше левой границы предыдущего, одинаковые шаблоны
+    // ищутся один раз, а шаблон, продолжающий уже найденный, ищется только внутри его отрезка и сравнивается
+    // с суффиксами с конца этого общего префикса. Отсортированная пачка делится на BATCH_LANES частей, двоичные поиски
+    // частей идут вперемешку по шагу, и каждый шаг заранее подгружает (prefetch) строку массива и байты текста
+    // для следующего шага. При n_threads > 1 пачка делится между потоками
+    [[nodiscard]] std::vector<std::span<const int>> SearchBatch(const std::vector<std::string>& patterns,
+                                                              int n_threads = 1) const {
+        std::vector<int> order(patterns.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return patterns[a] < patterns[b];
+        });
+        std::vector<std::span<const int>> ans(patterns.size());
+        n_threads = std::max(1, std::min<int>(n_threads, order.size() / BATCH_LANES));
+        if (n_threads == 1) {
+            RunBatch(patterns, order, 0, order.size(), ans);
+            return ans;
+        }
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < n_threads; ++thread) {
+            size_t begin = order.size() * thread / n_threads;
+            size_t end = order.size() * (thread + 1) / n_threads;
+            threads.emplace_back([&, begin, end] { RunBatch(patterns, order, begin, end, ans); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        return ans;
+    }
+
+    // шаблоны order[begin..end) по BATCH_LANES частям: шаг A читает подгруженные строки массива и подгружает текст,
+    // шаг B сравнивает, сдвигает границы и подгружает следующую строку
+    void RunBatch(const std::vector<std::string>& patterns, const std::vector<int>& order, size_t begin, size_t end,
+                  std::vector<std::span<const int>>& ans) const {
+        std::span<const int> array = Array();
+        std::string_view text = Text();
+        size_t n_lanes = std::min<size_t>(BATCH_LANES, end - begin);
+        std::vector<BatchLane> lanes(n_lanes);
+        for (size_t i = 0; i < n_lanes; ++i) {
+            lanes[i].next = begin + (end - begin) * i / n_lanes;
+            lanes[i].end = begin + (end - begin) * (i + 1) / n_lanes;
+            AdvanceLane(lanes[i], patterns, order, ans);
+        }
+        for (bool active = true; active;) {
+            active = false;
+            for (BatchLane& lane : lanes) {
+                if (lane.middle >= 0) {
+                    lane.position = array[lane.middle];
+                    __builtin_prefetch(text.data() + lane.position + std::max(lane.known, std::min(lane.l, lane.r)));
+                }
+            }
+            for (BatchLane& lane : lanes) {
+                if (lane.middle < 0) {
+                    continue;
+                }
+                const std::string& pattern = patterns[lane.query];
+                int common = common_prefix(pattern, lane.position, std::max(lane.known, std::min(lane.l, lane.r)));
+                if (is_right(pattern, common, lane.position, lane.upper)) {
+                    lane.right = lane.middle;
+                    lane.r = common;
+                } else {
+                    lane.left = lane.middle;
+                    lane.l = common;
+                }
+                AdvanceLane(lane, patterns, order, ans);
+                active = true;
+            }
+        }
+    }
+
+    // ведет часть пачки до следующей строки, которую нужно сравнить, и подгружает ее; закончившиеся поиски
+    // границ записываются в ans, и начинается поиск следующей границы или следующего шаблона
+    void AdvanceLane(BatchLane& lane, const std::vector<std::string>& patterns, const std::vector<int>& order,
+                     std::vector<std::span<const int>>& ans) const {
+        std::span<const int> array = Array();
+        while (true) {
+            if (lane.query >= 0 && lane.left + 1 < lane.right) {
+                lane.middle = lane.left + (lane.right - lane.left) / 2;
+                __builtin_prefetch(array.data() + lane.middle);
+                return;
+            }
+            if (lane.query >= 0 && !lane.upper) {
+                // левая граница найдена, правая не левее ее и не правее конца отрезка префикса
+                lane.found_left = lane.right;
+                lane.upper = true;
+                lane.left = lane.found_left - 1;
+                lane.right = lane.prefixes.empty() ? n : std::get<2>(lane.prefixes.back());
+                lane.l = lane.r = lane.known;
+                continue;
+            }
+            if (lane.query >= 0) {
+                ans[lane.query] = array.subspan(lane.found_left, lane.right - lane.found_left);
+                lane.prefixes.emplace_back(lane.query, lane.found_left, lane.right);
+                lane.previous_left = lane.found_left;
+                // одинаковые шаблоны стоят подряд: их ответ копируется без поиска и без второй записи в prefixes
+                while (lane.next < lane.end && patterns[order[lane.next]] == patterns[lane.query]) {
+                    ans[order[lane.next++]] = ans[lane.query];
+                }
+            }
+            if (lane.next == lane.end) {
+                lane.query = -1;
+                lane.middle = -1;
+                return;
+            }
+            int query = order[lane.next++];
+            const std::string& pattern = patterns[query];
+            lane.query = query;
+            while (!lane.prefixes.empty() && !pattern.starts_with(patterns[std::get<0>(lane.prefixes.back())])) {
+                lane.prefixes.pop_back();
+            }
+            // левая граница - в [max(previous_left, начало отрезка префикса), конец отрезка префикса]
+            lane.known = 0;
+            int low = lane.previous_left;
+            lane.right = n;
+            if (!lane.prefixes.empty()) {
+                const auto& [prefix, prefix_left, prefix_right] = lane.prefixes.back();
+                lane.known = patterns[prefix].size();
+                low = std::max(low, prefix_left);
+                lane.right = prefix_right;
+            }
+            lane.upper = false;
+            lane.left = low - 1;
+            lane.l = lane.r = lane.known;
+        }
+    }
+
+    // '?' в pattern обозначает любой символ; возвращает отсортированные позиции вхождений.
+    // Самый редкий кусок между '?' (по размеру отрезка суффиксного массива) дает кандидатов, остальные куски
+    // сверяются с текстом на месте. Если кандидатов слишком много, дешевле один проход Shift-And по тексту
+    std::vector<int> RegularSearch(const std::string& pattern) const {
+        int length = pattern.size();
+        int text_size = n - 1;
+        // куски между '?': (смещение в pattern, кусок); пустые куски от подряд идущих '?' не нужны
+        std::vector<std::pair<int, std::string>> fragments;
+        for (int i = 0; i < length;) {
+            int end = i;
+            while (end < length && pattern[end] != '?') {
+                ++end;
+            }
+            if (end > i) {
+                fragments.emplace_back(i, pattern.substr(i, end - i));
+            }
+            i = end + 1;
+        }
+        std::vector<int> ans;
+        if (length > text_size) {
+            return ans;
+        }
+        if (fragments.empty()) {
+            ans.resize(text_size - length + 1);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        size_t best = 0;
+        std::span<const int> candidates = SearchRange(fragments[0].second);
+        for (size_t f = 1; f < fragments.size(); ++f) {
+            std::span<const int> found = SearchRange(fragments[f].second);
+            if (found.size() < candidates.size()) {
+                best = f;
+                candidates = found;
+            }
+        }
+        if (length <= SHIFT_AND_MAX_LENGTH && candidates.size() * SHIFT_AND_RATIO > static_cast<size_t>(text_size)) {
+            return ShiftAndSearch(pattern);
+        }
+        std::string_view text = Text();
+        for (int found_pos : candidates) {
+            int start = found_pos - fragments[best].first;
+            if (start < 0 || start + length > text_size) {
+                continue;
+            }
+            bool matches = true;
+            for (size_t f = 0; f < fragments.size() && matches; ++f) {
+                matches = f == best || text.compare(start + fragments[f].first, fragments[f].second.size(),
+                                                    fragments[f].second) == 0;
+            }
+            if (matches) {
+                ans.push_back(start);
+            }
+        }
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+
+    // поиск pattern с '?' одним проходом по тексту (Shift-And): бит j состояния - совпадение pattern[0..j]
+    // с концом прочитанного текста; длина pattern не больше 64
+    std::vector<int> ShiftAndSearch(const std::string& pattern) const {
+        int length = pattern.size();
+        std::vector<int> ans;
+        if (length == 0 || length > SHIFT_AND_MAX_LENGTH) {
+            return length == 0 ? Search(pattern) : ans;
+        }
+        uint64_t masks[256];
+        for (uint64_t& mask : masks) {
+            mask = 0;
+        }
+        for (int j = 0; j < length; ++j) {
+            for (int c = 0; c < 256; ++c) {
+                if (pattern[j] == '?' || static_cast<unsigned char>(pattern[j]) == c) {
+                    masks[c] |= uint64_t(1) << j;
+                }
+            }
+        }
+        std::string_view text = Text();
+        const uint64_t last = uint64_t(1) << (length - 1);
+        uint64_t state = 0;
+        for (int i = 0; i < n - 1; ++i) {
+            state = ((state << 1) | 1) & masks[static_cast<unsigned char>(text[i])];
+            if (state & last) {
+                ans.push_back(i - length + 1);
+            }
+        }
+        return ans;
+    }
+
+    // позиции (по возрастанию), с которых pattern совпадает с текстом во всех символах, кроме не более чем k.
+    // Принцип Дирихле: pattern режется на k + 1 кусок, хотя бы один кусок входит в текст точно; его вхождения
+    // из суффиксного массива - кандидаты, которые сверяются с текстом, поэтому цена растет с k, а не с N
+    std::vector<int> HammingSearch(const std::string& pattern, int k) const {
+        int length = pattern.size();
+        int text_size = n - 1;
+        std::vector<int> ans;
+        if (length > text_size) {
+            return ans;
+        }
+        if (length <= k) {
+            ans.resize(text_size - length + 1);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        std::vector<int> candidates;
+        for (int piece = 0; piece <= k; ++piece) {
+            int begin = piece * length / (k + 1);
+            int end = (piece + 1) * length / (k + 1);
+            for (int pos : SearchRange(pattern.substr(begin, end - begin))) {
+                int start = pos - begin;
+                if (start >= 0 && start + length <= text_size) {
+                    candidates.push_back(start);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        std::string_view text = Text();
+        for (int start : candidates) {
+            int mismatches = 0;
+            for (int j = 0; j < length && mismatches <= k; ++j) {
+                mismatches += text[start + j] != pattern[j];
+            }
+            if (mismatches <= k) {
+                ans.push_back(start);
+            }
+        }
+        return ans;
+    }
+
+    // позиции (по возрастанию), с которых начинается подстрока текста на расстоянии редактирования не больше k
+    // от pattern. Тот же принцип Дирихле: точно входящий кусок сдвинут от начала вхождения не больше чем на k
+    std::vector<int> EditSearch(const std::string& pattern, int k) const {
+        int length = pattern.size();
+        int text_size = n - 1;
+        std::vector<int> ans;
+        if (length <= k) {
+            ans.resize(text_size + 1);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        std::vector<int> candidates;
+        for (int piece = 0; piece <= k; ++piece) {
+            int begin = piece * length / (k + 1);
+            int end = (piece + 1) * length / (k + 1);
+            for (int pos : SearchRange(pattern.substr(begin, end - begin))) {
+                for (int start = std::max(0, pos - begin - k); start <= std::min(text_size, pos - begin + k); ++start) {
+                    candidates.push_back(start);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        std::vector<int> previous;
+        std::vector<int> current;
+        for (int start : candidates) {
+            if (PrefixEditDistance(start, pattern, k, previous, current) <= k) {
+                ans.push_back(start);
+            }
+        }
+        return ans;
+    }
+
+    // минимум по end расстояния редактирования между pattern и text[start..end), но не больше k + 1:
+    // считаются только клетки в полосе |i - j| <= k, previous и current - рабочие строки таблицы
+    int PrefixEditDistance(int start, const std::string& pattern, int k, std::vector<int>& previous,
+                           std::vector<int>& current) const {
+        std::string_view text = Text();
+        int length = pattern.size();
+        int width = std::min(length + k, n - 1 - start);
+        previous.resize(width + 1);
+        current.resize(width + 1);
+        for (int j = 0; j <= width; ++j) {
+            previous[j] = std::min(j, k + 1);
+        }
+        for (int i = 1; i <= length; ++i) {
+            int from = std::max(0, i - k);
+            int to = std::min(width, i + k);
+            if (from > to) {
+                return k + 1;
+            }
+            int row_min = k + 1;
+            for (int j = from; j <= to; ++j) {
+                int value = k + 1;
+                if (j == 0) {
+                    value = i;
+                } else {
+                    value = std::min(value, previous[j - 1] + (text[start + j - 1] != pattern[i - 1]));
+                    value = std::min(value, previous[j] + 1);
+                    if (j > from) {
+                        value = std::min(value, current[j - 1] + 1);
+                    }
+                }
+                current[j] = std::min(value, k + 1);
+                row_min = std::min(row_min, current[j]);
+            }
+            // клетка правее полосы: в следующей строке читается как previous[j]
+            if (to < width) {
+                current[to + 1] = k + 1;
+            }
+            if (row_min > k) {
+                return k + 1;
+            }
+            std::swap(previous, current);
+        }
+        int best = k + 1;
+        for (int j = std::max(0, length - k); j <= std::min(width, length + k); ++j) {
+            best = std::min(best, previous[j]);
+        }
+        return best;
+    }
+
+    // повтор: подстрока text[position..position + length), которая встречается count раз
+    struct Repeat {
+        int position;
+        int length;
+        int count;
+
+        bool operator==(const Repeat&) const = default;
+    };
+
+    // общая подстрока двух строк: first[first_position..] и second[second_position..] совпадают на length символах
+    struct CommonSubstring {
+        int first_position;
+        int second_position;
+        int length;
+    };
+
+    // самая длинная подстрока, которая встречается хотя бы дважды (первое вхождение): наибольший элемент LCP, O(N)
+    [[nodiscard]] Repeat LongestRepeatedSubstring() const {
+        std::span<const int> array = Array();
+        std::span<const int> lcp_array = LCP();
+        int row = 0;
+        for (int i = 1; i < n; ++i) {
+            if (lcp_array[i] > lcp_array[row]) {
+                row = i;
+            }
+        }
+        Repeat ans{0, 0, 0};
+        if (row == 0 || lcp_array[row] == 0) {
+            return ans;
+        }
+        // вхождения - соседние строки с LCP не меньше длины повтора
+        int left = row - 1;
+        int right = row;
+        while (left > 0 && lcp_array[left] >= lcp_array[row]) {
+            --left;
+        }
+        while (right + 1 < n && lcp_array[right + 1] >= lcp_array[row]) {
+            ++right;
+        }
+        ans = {array[left], lcp_array[row], right - left + 1};
+        for (int i = left; i <= right; ++i) {
+            ans.position = std::min(ans.position, array[i]);
+        }
+        return ans;
+    }
+
+    // максимальные повторы длины не меньше min_length (нельзя продлить ни влево, ни вправо, не потеряв вхождений),
+    // по возрастанию (position, length); position - первое вхождение. Каждый повтор - LCP-интервал: строки
+    // суффиксного массива с общим префиксом длины lcp, у которых следующие символы различаются; повтор максимален
+    // слева, если различаются и символы перед вхождениями. Интервалы перебираются стеком за O(N)
+    [[nodiscard]] std::vector<Repeat> MaximalRepeats(int min_length = 1) const {
+        std::span<const int> array = Array();
+        std::span<const int> lcp_array = LCP();
+        std::string_view text = Text();
+        // символ перед вхождениями интервала: байт, NO_SYMBOL (пустой интервал) или DIVERSE (разные символы)
+        const int NO_SYMBOL = -1;
+        const int DIVERSE = -2;
+        auto merge = [&](int a, int b) {
+            return a == NO_SYMBOL ? b : b == NO_SYMBOL || a == b ? a : DIVERSE;
+        };
+        struct Interval {
+            int lcp;
+            int left;
+            int symbol;
+            int first;
+        };
+        std::vector<Repeat> ans;
+        std::vector<Interval> stack = {{0, 0, NO_SYMBOL, n}};
+        for (int i = 1; i <= n; ++i) {
+            int current = i < n ? lcp_array[i] : 0;
+            // строка i - 1 и вложенные интервалы, закрывшиеся на этой границе
+            int left = i - 1;
+            int symbol = array[i - 1] == 0 ? DIVERSE : static_cast<unsigned char>(text[array[i - 1] - 1]);
+            int first = array[i - 1];
+            while (current < stack.back().lcp) {
+                Interval interval = stack.back();
+                stack.pop_back();
+                interval.symbol = merge(interval.symbol, symbol);
+                interval.first = std::min(interval.first, first);
+                if (interval.lcp >= min_length && interval.symbol == DIVERSE) {
+                    ans.push_back({interval.first, interval.lcp, i - interval.left});
+                }
+                left = interval.left;
+                symbol = interval.symbol;
+                first = interval.first;
+            }
+            if (current > stack.back().lcp) {
+                stack.push_back({current, left, symbol, first});
+            } else {
+                stack.back().symbol = merge(stack.back().symbol, symbol);
+                stack.back().first = std::min(stack.back().first, first);
+            }
+        }
+        std::sort(ans.begin(), ans.end(), [](const Repeat& a, const Repeat& b) {
+            return a.position != b.position ? a.position < b.position : a.length < b.length;
+        });
+        return ans;
+    }
+
+    // число различных непустых подстрок: у каждого суффикса новые только префиксы длиннее LCP с предыдущим
+    [[nodiscard]] int64_t DistinctSubstrings() const {
+        std::span<const int> lcp_array = LCP();
+        int64_t length = n - 1;
+        int64_t ans = length * (length + 1) / 2;
+        for (int i = 1; i < n; ++i) {
+            ans -= lcp_array[i];
+        }
+        return ans;
+    }
+
+    // самая длинная общая подстрока first и second за O(|first| + |second|) по суффиксному массиву first + second
+    // без разделителя: общий префикс суффикса first обрезается концом first. В строке i best[s] - наибольшая
+    // длина, на которую строка стороны s выше совпадает со строкой i; переход к следующей строке ограничивает
+    // все такие длины одним и тем же lcp, поэтому их максимум ограничивается тем же lcp
+    static CommonSubstring LongestCommonSubstring(const std::string& first, const std::string& second) {
+        SuffixArray index(first + second, Builder::SAIS);
+        std::span<const int> array = index.Array();
+        std::span<const int> lcp_array = index.LCP();
+        int first_size = first.size();
+        int text_size = index.n - 1;
+        CommonSubstring ans{0, 0, 0};
+        int best[2] = {0, 0};
+        int best_position[2] = {0, 0};
+        for (int i = 0; i < index.n; ++i) {
+            if (i > 0) {
+                best[0] = std::min(best[0], lcp_array[i]);
+                best[1] = std::min(best[1], lcp_array[i]);
+            }
+            int position = array[i];
+            int side = position < first_size ? 0 : 1;
+            int limit = side == 0 ? first_size - position : text_size - position;
+            int length = std::min(best[1 - side], limit);
+            if (length > ans.length) {
+                ans = side == 0 ? CommonSubstring{position, best_position[1] - first_size, length}
+                                : CommonSubstring{best_position[0], position - first_size, length};
+            }
+            if (limit >= best[side]) {
+                best[side] = limit;
+                best_position[side] = position;
+            }
+        }
+        return ans;
+    }
+
+    // возвращает наименьший суффикс, больший или равный pattern
+    int left_bound(const std::string& pattern) const {
+        return bound(pattern, false);
+    }
+
+    // возвращает наименьший суффикс, больший pattern (суффиксы, начинающиеся с pattern, меньше)
+    int right_bound(const std::string& pattern) const {
+        return bound(pattern, true);
+    }
+
+    // двоичный поиск Манбера-Майерса за O(P + log N): l и r - длины общих префиксов pattern с суффиксами
+    // на границах отрезка, lcp_lr говорит, сколько символов середина делит с границей, и позволяет
+    // сравнивать pattern с серединой не с начала
+    int bound(const std::string& pattern, bool upper) const {
+        stats::ScopedTimer timer(stats::Timer::SuffixArrayBound);
+        std::span<const int> array = Array();
+        std::span<const int> lcp_lr = LCPLR();
+        int l = common_prefix(pattern, array[0], 0);
+        if (is_right(pattern, l, array[0], upper)) {
+            return 0;
+        }
+        int r = common_prefix(pattern, array[n - 1], 0);
+        if (!is_right(pattern, r, array[n - 1], upper)) {
+            return n;
+        }
+        int left = 0;
+        int right = n - 1;
+        while (left + 1 < right) {
+            int middle = left + (right - left) / 2;
+            int left_lcp = lcp_lr[2 * middle];
+            int right_lcp = lcp_lr[2 * middle + 1];
+            if (l > r && left_lcp != l) {
+                // середина расходится с левой границей позже pattern - pattern правее, раньше - левее
+                if (left_lcp > l) {
+                    left = middle;
+                } else {
+                    right = middle;
+                    r = left_lcp;
+                }
+                continue;
+            }
+            if (r > l && right_lcp != r) {
+                if (right_lcp > r) {
+                    right = middle;
+                } else {
+                    left = middle;
+                    l = right_lcp;
+                }
+                continue;
+            }
+            // середина совпадает с pattern хотя бы в max(l, r) символах, сравниваем дальше
+            int common = common_prefix(pattern, array[middle], std::max(l, r));
+            if (is_right(pattern, common, array[middle], upper)) {
+                right = middle;
+                r = common;
+            } else {
+                left = middle;
+                l = common;
+            }
+        }
+        return right;
+    }
+
+    // длина общего префикса pattern и суффикса pos, если первые common символов уже совпали
+    // суффикс pos, общий префикс которого с pattern равен common, лежит правее искомой границы
+    bool is_right(const std::string& pattern, int common, int pos, bool upper) const {
+        if (common == static_cast<int>(pattern.size())) {
+            return !upper;
+        }
+        // сентинел больше любого байта
+        return pos + common == n - 1 ||
+               static_cast<unsigned char>(pattern[common]) < static_cast<unsigned char>(Text()[pos + common]);
+    }
+
+    int common_prefix(const std::string& pattern, int pos, int common) const {
+        std::string_view text = Text();
+        int length = pattern.size();
+        int start = common;
+        while (common < length && pos + common < n - 1 && pattern[common] == text[pos + common]) {
+            ++common;
+        }
+        stats::Add(stats::Counter::SuffixArrayProbes);
+        stats::Add(stats::Counter::SuffixArrayByteComparisons,
+                   common - start + (common < length && pos + common < n - 1 ? 1 : 0));
+        return common;
+    }
+
+    // перенумеровывает встречающиеся байты по возрастанию: symbols[i] - номер str[i] среди них (0..sigma - 1),
+    // у сентинела номер sigma; возвращает размер алфавита вместе с сентинелом
+    int RemapAlphabet(std::vector<int>& symbols) const {
+        std::vector<int> rank(256);
+        for (int i = 0; i < n - 1; ++i) {
+            rank[static_cast<unsigned char>(str[i])] = 1;
+        }
+        int sigma = 0;
+        for (int& c : rank) {
+            int occurs = c;
+            c = sigma;
+            sigma += occurs;
+        }
+        symbols.resize(n);
+        for (int i = 0; i < n - 1; ++i) {
+            symbols[i] = rank[static_cast<unsigned char>(str[i])];
+        }
+        symbols[n - 1] = sigma;
+        return sigma + 1;
+    }
+
+    std::vector<int> count_sort() {
+        std::vector<int> s;
+        int alphabet_size = RemapAlphabet(s);
+        std::vector<int> cnt(alphabet_size);
+        // подсчет каждого символа
+        for (int c : s) {
+            ++cnt[c];
+        }
+        // cnt[i] - место, на котором должен стоять символ с номером i
+        for (int i = 1; i < alphabet_size; ++i) {
+            cnt[i] += cnt[i - 1];
+        }
+        std::vector<int> p(n);
+        // p[k] = i означает, что на k месте в отсортированном списке стоит s[i]
+        for (int i = 0; i < n; ++i) {
+            p[--cnt[s[i]]] = i;
+        }
+        // раскидываем символы по классам
+        std::vector<int> classes(n);
+        int curr_class = 0;
+        classes[0] = curr_class;
+        for (int i = 1; i < n; ++i) {
+            if (s[p[i]] != s[p[i - 1]]) {
+                ++curr_class;
+            }
+            classes[p[i]] = curr_class;
+        }
+
+        return classes;
+    }
+
+    std::vector<int> count_pair_sort(const std::vector<std::pair<int, int>>& pairs) const {
+        std::vector<int> cnt(n);
+        // сортируем по pair.second
+        for (int i = 0; i < n; ++i) {
+            ++cnt[pairs[i].second];
+        }
+        for (int i = 1; i < n; ++i) {
+            cnt[i] += cnt[i - 1];
+        }
+
+        std::vector<int> p_second(n);
+        // p_second[k] = i означает, что на k месте в отсортированном списке по pair.second стоит pairs[i]
+        for (int i = n - 1; i >= 0; --i) {
+            p_second[--cnt[pairs[i].second]] = i;
+        }
+        std::vector<std::pair<int, int>> second_cnt_sort(n);
+        for (int i = 0; i < n; ++i) {
+            second_cnt_sort[i] = pairs[p_second[i]];
+        }
+
+        cnt.assign(n, 0);
+        // сортируем по pair.first
+        for (int i = 0; i < n; ++i) {
+            ++cnt[second_cnt_sort[i].first];
+        }
+        for (int i = 1; i < n; ++i) {
+            cnt[i] += cnt[i - 1];
+        }
+
+        std::vector<int> p_first(n);
+        // p_first[k] = i означает, что на k месте в отсортированном списке стоит second_cnt_sort[i]
+        for (int i = n - 1; i >= 0; --i) {
+            p_first[--cnt[second_cnt_sort[i].first]] = i;
+        }
+        // композиция двух перемещений
+        std::vector<int> p(n);
+        for (int i = 0; i < n; ++i) {
+            p[i] = p_second[p_first[i]];
+        }
+        std::vector<int> classes(n);
+        int curr_class = 0;
+        classes[p[0]] = 0;
+        for (int i = 1; i < n; ++i) {
+            if (pairs[p[i]] != pairs[p[i - 1]]) {
+                ++curr_class;
+            }
+            classes[p[i]] = curr_class;
+        }
+        return classes;
+    }
+
+    // классы пар (classes[j], classes[j + shift]) как у count_pair_sort, но в n_threads потоках: пара упаковывается
+    // в 64-битный ключ и сортируется поразрядно (LSD) цифрами по RADIX_BITS бит. На каждом проходе поток считает
+    // гистограмму цифр своего куска, префиксные суммы по (цифра, кусок) дают каждому потоку его места в выходе,
+    // поэтому сортировка устойчива и результат совпадает с последовательным
+    std::vector<int> parallel_pair_sort(const std::vector<int>& classes, int shift, int n_threads) const {
+        const int bits = std::bit_width(static_cast<unsigned>(n));
+        std::vector<uint64_t> keys(n);
+        std::vector<int> order(n);
+        ParallelFor(n_threads, [&](int, int begin, int end) {
+            for (int j = begin; j < end; ++j) {
+                keys[j] = (static_cast<uint64_t>(classes[j]) << bits) | classes[(j + shift) % n];
+                order[j] = j;
+            }
+        });
+        std::vector<uint64_t> keys_buffer(n);
+        std::vector<int> order_buffer(n);
+        std::vector<std::vector<int>> counts(n_threads, std::vector<int>(1 << RADIX_BITS));
+        for (int low = 0; low < 2 * bits; low += RADIX_BITS) {
+            auto digit = [&](uint64_t key) {
+                return static_cast<int>((key >> low) & ((1 << RADIX_BITS) - 1));
+            };
+            ParallelFor(n_threads, [&](int thread, int begin, int end) {
+                std::fill(counts[thread].begin(), counts[thread].end(), 0);
+                for (int j = begin; j < end; ++j) {
+                    ++counts[thread][digit(keys[j])];
+                }
+            });
+            int offset = 0;
+            for (int d = 0; d < (1 << RADIX_BITS); ++d) {
+                for (int thread = 0; thread < n_threads; ++thread) {
+                    int count = counts[thread][d];
+                    counts[thread][d] = offset;
+                    offset += count;
+                }
+            }
+            ParallelFor(n_threads, [&](int thread, int begin, int end) {
+                for (int j = begin; j < end; ++j) {
+                    int pos = counts[thread][digit(keys[j])]++;
+                    keys_buffer[pos] = keys[j];
+                    order_buffer[pos] = order[j];
+                }
+            });
+            keys.swap(keys_buffer);
+            order.swap(order_buffer);
+        }
+        // новый класс начинается там, где ключ отличается от предыдущего: число границ в кусках, затем
+        // каждый поток нумерует свой кусок от суммы границ в предыдущих
+        std::vector<int> first_class(n_threads + 1, 0);
+        ParallelFor(n_threads, [&](int thread, int begin, int end) {
+            for (int i = std::max(begin, 1); i < end; ++i) {
+                first_class[thread + 1] += keys[i] != keys[i - 1];
+            }
+        });
+        for (int thread = 0; thread < n_threads; ++thread) {
+            first_class[thread + 1] += first_class[thread];
+        }
+        std::vector<int> new_classes(n);
+        ParallelFor(n_threads, [&](int thread, int begin, int end) {
+            int curr_class = first_class[thread];
+            for (int i = begin; i < end; ++i) {
+                if (i > 0 && keys[i] != keys[i - 1]) {
+                    ++curr_class;
+                }
+                new_classes[order[i]] = curr_class;
+            }
+        });
+        return new_classes;
+    }
+
+    // делит [0, n) на n_threads кусков подряд и вызывает f(thread, begin, end) для каждого в своем потоке
+    template <class F>
+    void ParallelFor(int n_threads, F&& f) const {
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < n_threads; ++thread) {
+            int begin = static_cast<int64_t>(n) * thread / n_threads;
+            int end = static_cast<int64_t>(n) * (thread + 1) / n_threads;
+            threads.emplace_back([&f, thread, begin, end] { f(thread, begin, end); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // степени двойки до первой, не меньшей max_number - 1: циклические сдвиги с уникальным сентинелом
+    // различаются в первых max_number - 1 символах
+    static std::vector<int> powers_of_2(int max_number) {
+        std::vector<int> powers = {1};
+        while (powers.back() < max_number - 1) {
+            powers.push_back(powers.back() * 2);
+        }
+        return powers;
+    }
+};
+
+// битовый вектор с rank за O(1): на каждые 512 бит хранится число единиц до них
+class RankBitVector {
+public:
+    RankBitVector() = default;
+
+    explicit RankBitVector(int size) : words(size / 64 + 1) {}
+
+    void Set(int i) {
+        words[i >> 6] |= 1ull << (i & 63);
+    }
+
+    // вызывается после всех Set
+    void Build() {
+        block_rank.assign(words.size() / WORDS_IN_BLOCK + 1, 0);
+        int ones = 0;
+        for (size_t w = 0; w < words.size(); ++w) {
+            if (w % WORDS_IN_BLOCK == 0) {
+                block_rank[w / WORDS_IN_BLOCK] = ones;
+            }
+            ones += __builtin_popcountll(words[w]);
+        }
+    }
+
+    bool operator[](int i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    // число единиц в [0, i)
+    int Rank1(int i) const {
+        int word = i >> 6;
+        int ones = block_rank[word / WORDS_IN_BLOCK];
+        for (int w = word - word % WORDS_IN_BLOCK; w < word; ++w) {
+            ones += __builtin_popcountll(words[w]);
+        }
+        return ones + __builtin_popcountll(words[word] & ((1ull << (i & 63)) - 1));
+    }
+
+    int Rank0(int i) const {
+        return i - Rank1(i);
+    }
+
+    [[nodiscard]] size_t MemoryBytes() const {
+        return words.capacity() * sizeof(uint64_t) + block_rank.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    static const int WORDS_IN_BLOCK = 8;
+
+    std::vector<uint64_t> words;
+    std::vector<uint32_t> block_rank;
+};
+
+// вейвлет-дерево формы дерева Хаффмана: символ с частотой f занимает около log(N / f) бит,
+// всего около N * H0 бит
+class WaveletTree {
+public:
+    WaveletTree() = default;
+
+    WaveletTree(const std::vector<int>& symbols, int alphabet_size) : codes(alphabet_size) {
+        std::vector<int> frequency(alphabet_size);
+        for (int c : symbols) {
+            ++frequency[c];
+        }
+        // строим дерево Хаффмана, лист с символом c кодируется как -(c + 1)
+        std::vector<std::pair<long long, int>> heap;
+        for (int c = 0; c < alphabet_size; ++c) {
+            if (frequency[c] > 0) {
+                heap.emplace_back(-frequency[c], -(c + 1));
+            }
+        }
+        if (heap.empty()) {
+            return;
+        }
+        std::make_heap(heap.begin(), heap.end());
+        std::vector<long long> node_size;
+        while (heap.size() > 1) {
+            std::pop_heap(heap.begin(), heap.end());
+            auto[first_weight, first] = heap.back();
+            heap.pop_back();
+            std::pop_heap(heap.begin(), heap.end());
+            auto[second_weight, second] = heap.back();
+            heap.pop_back();
+            nodes.push_back({RankBitVector(), {first, second}});
+            node_size.push_back(-(first_weight + second_weight));
+            heap.emplace_back(first_weight + second_weight, nodes.size() - 1);
+            std::push_heap(heap.begin(), heap.end());
+        }
+        root = heap[0].second;
+        if (root < 0) {
+            return;
+        }
+        // коды символов: путь от корня до листа
+        std::vector<std::pair<int, std::vector<std::pair<int, bool>>>> stack = {{root, {}}};
+        while (!stack.empty()) {
+            auto[node, path] = std::move(stack.back());
+            stack.pop_back();
+            for (int bit = 0; bit < 2; ++bit) {
+                std::vector<std::pair<int, bool>> child_path = path;
+                child_path.emplace_back(node, bit);
+                int child = nodes[node].child[bit];
+                if (child < 0) {
+                    codes[-child - 1] = std::move(child_path);
+                } else {
+                    stack.emplace_back(child, std::move(child_path));
+                }
+            }
+        }
+        // один проход по строке: каждый символ дописывает по биту во все вершины на своем пути
+        std::vector<int> filled(nodes.size());
+        for (size_t v = 0; v < nodes.size(); ++v) {
+            nodes[v].bits = RankBitVector(node_size[v]);
+        }
+        for (int c : symbols) {
+            for (auto[node, bit] : codes[c]) {
+                if (bit) {
+                    nodes[node].bits.Set(filled[node]);
+                }
+                ++filled[node];
+            }
+        }
+        for (Node& node : nodes) {
+            node.bits.Build();
+        }
+    }
+
+    // число символов c среди первых i
+    int Rank(int c, int i) const {
+        if (root < 0) {
+            return root == -(c + 1) ? i : 0;
+        }
+        if (c >= static_cast<int>(codes.size()) || codes[c].empty()) {
+            return 0;
+        }
+        for (auto[node, bit] : codes[c]) {
+            i = bit ? nodes[node].bits.Rank1(i) : nodes[node].bits.Rank0(i);
+        }
+        return i;
+    }
+
+    // символ на позиции i и число таких же символов перед ним
+    std::pair<int, int> AccessRank(int i) const {
+        int node = root;
+        while (node >= 0) {
+            bool bit = nodes[node].bits[i];
+            i = bit ? nodes[node].bits.Rank1(i) : nodes[node].bits.Rank0(i);
+            node = nodes[node].child[bit];
+        }
+        return {-node - 1, i};
+    }
+
+    [[nodiscard]] size_t MemoryBytes() const {
+        size_t bytes = 0;
+        for (const Node& node : nodes) {
+            bytes += sizeof(Node) + node.bits.MemoryBytes();
+        }
+        return bytes;
+    }
+
+private:
+    struct Node {
+        RankBitVector bits;
+        // child >= 0 - внутренняя вершина, child < 0 - лист с символом -child - 1
+        int child[2];
+    };
+
+    std::vector<Node> nodes;
+    int root = -1;
+    std::vector<std::vector<std::pair<int, bool>>> codes;
+};
+
+// сжатый индекс (FM-индекс): BWT в вейвлет-дереве и каждый sample_rate-й элемент суффиксного массива.
+// Count за O(P log sigma) не обращается к позициям, Search находит каждую позицию не более чем за sample_rate шагов LF
+class FMIndex {
+public:
+    explicit FMIndex(const SuffixArray& index, int sample_rate = 32)
+            : n(index.n), sample_rate(sample_rate), count_less(ALPHABET_SIZE + 1), sampled(index.n) {
+        std::span<const int> array = index.Array();
+        std::string_view text = index.Text();
+        // BWT[i] - символ перед суффиксом array[i]: байт -> 0..255, сентинел -> 256
+        std::vector<int> bwt_symbols(n);
+        for (int i = 0; i < n; ++i) {
+            int pos = (array[i] + n - 1) % n;
+            bwt_symbols[i] = pos == n - 1 ? ALPHABET_SIZE - 1 : static_cast<unsigned char>(text[pos]);
+            ++count_less[bwt_symbols[i] + 1];
+        }
+        for (int c = 1; c <= ALPHABET_SIZE; ++c) {
+            count_less[c] += count_less[c - 1];
+        }
+        // в вейвлет-дереве Хаффмана есть листья только для встречающихся символов
+        bwt = WaveletTree(bwt_symbols, ALPHABET_SIZE);
+        // сэмплируем позиции текста, кратные sample_rate: от любой строки до сэмпла не больше sample_rate шагов
+        for (int i = 0; i < n; ++i) {
+            if (array[i] % sample_rate == 0) {
+                sampled.Set(i);
+                samples.push_back(array[i]);
+            }
+        }
+        sampled.Build();
+        samples.shrink_to_fit();
+    }
+
+    // число вхождений pattern без вычисления позиций
+    int Count(const std::string& pattern) const {
+        auto[left, right] = Rows(pattern);
+        return right - left;
+    }
+
+    // тот же результат, что SuffixArray::Search
+    std::vector<int> Search(const std::string& pattern) const {
+        if (pattern.empty()) {
+            std::vector<int> ans(n);
+            std::iota(ans.begin(), ans.end(), 0);
+            return ans;
+        }
+        auto[left, right] = Rows(pattern);
+        std::vector<int> ans;
+        ans.reserve(right - left);
+        for (int row = left; row < right; ++row) {
+            ans.push_back(Locate(row));
+        }
+        return ans;
+    }
+
+    [[nodiscard]] size_t MemoryBytes() const {
+        return bwt.MemoryBytes() + sampled.MemoryBytes() + samples.capacity() * sizeof(int) +
+               count_less.capacity() * sizeof(int);
+    }
+
+private:
+    // все байты и сентинел
+    static constexpr int ALPHABET_SIZE = 256 + 1;
+
+    int n;
+    int sample_rate;
+    // count_less[c] - число символов BWT, меньших c
+    std::vector<int> count_less;
+    WaveletTree bwt;
+    RankBitVector sampled;
+    std::vector<int> samples;
+
+    // обратный поиск: отрезок [left, right) строк суффиксного массива, начинающихся с pattern
+    std::pair<int, int> Rows(const std::string& pattern) const {
+        int left = 0;
+        int right = n;
+        for (auto it = pattern.rbegin(); it != pattern.rend() && left < right; ++it) {
+            int c = static_cast<unsigned char>(*it);
+            left = count_less[c] + bwt.Rank(c, left);
+            right = count_less[c] + bwt.Rank(c, right);
+        }
+        return {left, std::max(left, right)};
+    }
+
+    // позиция суффикса в строке row: шагаем LF к предыдущей позиции текста, пока не встретим сэмпл
+    int Locate(int row) const {
+        int steps = 0;
+        while (!sampled[row]) {
+            auto[c, rank] = bwt.AccessRank(row);
+            row = count_less[c] + rank;
+            ++steps;
+        }
+        return samples[sampled.Rank1(row)] + steps;
+    }
+};
+
+// позиция минимума на отрезке за O(1): разреженная таблица по минимумам блоков из 32 элементов и
+// просмотр не больше двух неполных блоков; памяти O(N / 32 * log N) сверх самого массива
+class RangeMinimum {
+public:
+    RangeMinimum() = default;
+
+    explicit RangeMinimum(std::vector<int> input) : values(std::move(input)) {
+        int blocks = (values.size() + BLOCK - 1) / BLOCK;
+        table.emplace_back(blocks);
+        for (int b = 0; b < blocks; ++b) {
+            table[0][b] = Scan(b * BLOCK, std::min<int>((b + 1) * BLOCK, values.size()));
+        }
+        for (int level = 1; (1 << level) <= blocks; ++level) {
+            table.emplace_back(blocks - (1 << level) + 1);
+            for (size_t b = 0; b < table[level].size(); ++b) {
+                table[level][b] = Min(table[level - 1][b], table[level - 1][b + (1 << (level - 1))]);
+            }
+        }
+    }
+
+    // позиция наименьшего элемента в [left, right), left < right; при равенстве - самая левая
+    int ArgMin(int left, int right) const {
+        int first_block = left / BLOCK;
+        int last_block = (right - 1) / BLOCK;
+        if (last_block - first_block <= 1) {
+            return Scan(left, right);
+        }
+        int best = Min(Scan(left, (first_block + 1) * BLOCK), Scan(last_block * BLOCK, right));
+        int from = first_block + 1;
+        int level = std::bit_width(static_cast<unsigned>(last_block - from)) - 1;
+        return Min(best, Min(table[level][from], table[level][last_block - (1 << level)]));
+    }
+
+    int operator[](int i) const {
+        return values[i];
+    }
+
+    [[nodiscard]] size_t MemoryBytes() const {
+        size_t bytes = values.capacity() * sizeof(int);
+        for (const std::vector<int>& level : table) {
+            bytes += level.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr int BLOCK = 32;
+
+    std::vector<int> values;
+    // table[level][b] - позиция минимума в блоках [b, b + 2^level)
+    std::vector<std::vector<int>> table;
+
+    int Min(int i, int j) const {
+        return values[j] < values[i] || (values[j] == values[i] && j < i) ? j : i;
+    }
+
+    int Scan(int left, int right) const {
+        int best = left;
+        for (int i = left + 1; i < right; ++i) {
+            if (values[i] < values[best]) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+// обобщенный суффиксный массив коллекции документов: документы склеиваются через разделитель в один текст,
+// document[row] - номер документа суффикса в строке row. Разделитель - наименьший байт, которого нет ни в одном
+// документе; если встречаются все 256 байтов, вхождения, пересекающие границу документа, отбрасываются при поиске
+class DocumentIndex {
+public:
+    struct Occurrence {
+        int document;
+        int offset;
+
+        bool operator==(const Occurrence&) const = default;
+    };
+
+    explicit DocumentIndex(const std::vector<std::string>& documents)
+            : separator(ChooseSeparator(documents)),
+              index(Concatenate(documents, separator, starts), SuffixArray::Builder::SAIS) {
+        std::span<const int> array = index.Array();
+        std::vector<int> document_of_position(index.n);
+        for (size_t d = 0; d + 1 < starts.size(); ++d) {
+            std::fill(document_of_position.begin() + starts[d], document_of_position.begin() + starts[d + 1], d);
+        }
+        // сентинел после последнего разделителя - фиктивный документ с номером documents.size()
+        document_of_position[index.n - 1] = documents.size();
+        document.resize(index.n);
+        std::vector<int> previous(index.n);
+        std::vector<int> last_row(documents.size() + 1, -1);
+        for (int row = 0; row < index.n; ++row) {
+            document[row] = document_of_position[array[row]];
+            previous[row] = last_row[document[row]];
+            last_row[document[row]] = row;
+        }
+        // previous[row] - предыдущая строка с тем же документом (-1, если ее нет)
+        previous_row = RangeMinimum(std::move(previous));
+    }
+
+    // вхождения pattern как (документ, смещение в документе), по возрастанию
+    std::vector<Occurrence> Locate(const std::string& pattern) const {
+        std::vector<Occurrence> ans;
+        if (pattern.empty()) {
+            for (size_t d = 0; d + 1 < starts.size(); ++d) {
+                for (int offset = 0; offset < starts[d + 1] - starts[d]; ++offset) {
+                    ans.push_back({static_cast<int>(d), offset});
+                }
+            }
+            return ans;
+        }
+        std::span<const int> array = index.Array();
+        int right = index.right_bound(pattern);
+        for (int row = index.left_bound(pattern); row < right; ++row) {
+            int offset = array[row] - starts[document[row]];
+            // starts[d + 1] - starts[d] включает разделитель, вхождение должно закончиться раньше него
+            if (offset + static_cast<int>(pattern.size()) < starts[document[row] + 1] - starts[document[row]]) {
+                ans.push_back({document[row], offset});
+            }
+        }
+        std::sort(ans.begin(), ans.end(), [](const Occurrence& a, const Occurrence& b) {
+            return a.document != b.document ? a.document < b.document : a.offset < b.offset;
+        });
+        return ans;
+    }
+
+    // документы (по возрастанию), в которых есть pattern, каждый по одному разу.
+    // Алгоритм Муту Кришнана: на отрезке [left, right) строк с pattern документ встречается впервые в строке row,
+    // если previous[row] < left; такие строки находятся минимумом на отрезке, и работа пропорциональна ответу
+    std::vector<int> ListDocuments(const std::string& pattern) const {
+        std::vector<int> ans;
+        if (pattern.empty() || pattern.find(separator) != std::string::npos) {
+            // pattern с байтом-разделителем может пересекать границы документов: проверяем каждое вхождение
+            for (const Occurrence& occurrence : Locate(pattern)) {
+                if (ans.empty() || ans.back() != occurrence.document) {
+                    ans.push_back(occurrence.document);
+                }
+            }
+            return ans;
+        }
+        int left = index.left_bound(pattern);
+        std::vector<std::pair<int, int>> stack = {{left, index.right_bound(pattern)}};
+        while (!stack.empty()) {
+            auto[begin, end] = stack.back();
+            stack.pop_back();
+            if (begin >= end) {
+                continue;
+            }
+            int row = previous_row.ArgMin(begin, end);
+            if (previous_row[row] >= left) {
+                continue;
+            }
+            ans.push_back(document[row]);
+            stack.emplace_back(begin, row);
+            stack.emplace_back(row + 1, end);
+        }
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+
+    [[nodiscard]] int DocumentCount() const {
+        return starts.size() - 1;
+    }
+
+    [[nodiscard]] size_t MemoryBytes() const {
+        return index.MemoryBytes() + document.capacity() * sizeof(int) + previous_row.MemoryBytes() +
+               starts.capacity() * sizeof(int);
+    }
+
+private:
+    char separator;
+    // starts[d] - начало документа d в склеенном тексте, starts.back() - длина текста без сентинела
+    std::vector<int> starts;
+    SuffixArray index;
+    std::vector<int> document;
+    RangeMinimum previous_row;
+
+    static std::string Concatenate(const std::vector<std::string>& documents, char separator,
+                                   std::vector<int>& starts) {
+        std::string text;
+        for (const std::string& document : documents) {
+            starts.push_back(text.size());
+            text += document;
+            text += separator;
+        }
+        starts.push_back(text.size());
+        return text;
+    }
+
+    static char ChooseSeparator(const std::vector<std::string>& documents) {
+        std::array<bool, 256> used{};
+        for (const std::string& document : documents) {
+            for (char c : document) {
+                used[static_cast<unsigned char>(c)] = true;
+            }
+        }
+        int byte = 0;
+        while (byte < 255 && used[byte]) {
+            ++byte;
+        }
+        return static_cast<char>(byte);
+    }
+};
@@ -1,147 +1,231 @@
+#include "suffix_tree.h"
+#include "corpus.h"
+
+#include <cassert>
 #include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
 #include <string>
 #include <vector>
-#include <map>
 
-struct Node {
-    int begin;
-    int end;
-    std::map<char, Node*> next;
-
-    Node(int start, int end) : begin(start), end(end) {}
-
-    int size() const {
-        return end - begin;
-    }
-};
-
-class SuffixTree {
-    Node* root;
-    std::string str;
-    int n;
-
-public:
-    // построение суффиксного дерева за O(N^2)
-    explicit SuffixTree(const std::string& input_str) : str(input_str + '$'), n(str.size()) {
-        root = new Node(0, 0);
-        // последовательно вставляем все суффиксы
-        for (int i = 0; i < static_cast<int>(str.size()); ++i) {
-            insert(i);
+void Check(const SuffixTree& tree, const std::string& str) {
+    for (int begin = 0; begin < static_cast<int>(str.size()); ++begin) {
+        for (int end = begin + 1; end <= static_cast<int>(str.size()); ++end) {
+            assert(tree.contains(str.substr(begin, end - begin)));
         }
     }
+}
 
-    void insert(int suffix_begin) {
-        // если от корня нет такой буквы, то вставляем новый лист
-        if (!root->next.contains(str[suffix_begin])) {
-            root->next[str[suffix_begin]] = new Node(suffix_begin, n);
-            return;
-        }
-        Node* node = root->next[str[suffix_begin]];
-        // идем по новому суффиксу
-        for (int i = suffix_begin; i < n;) {
-            // идем по буквам в текущем узле
-            for (int j = 0; j < node->size(); ++j) {
-                // если есть несовпадение, делаем ответвление
-                if (str[node->begin + j] != str[i + j]) {
-                    // новый лист
-                    Node* new_list = new Node(i + j, n);
-                    // новая внутренняя вершина
-                    Node* new_node = new Node(node->begin + j, node->end);
-                    node->end = node->begin + j;
-                    new_node->next = node->next;
-                    node->next.clear();
-                    node->next[str[node->begin + j]] = new_node;
-                    node->next[str[i + j]] = new_list;
-                    return;
-                }
-            }
-            i += node->size();
-            // если в следующях узлах нет такой буквы, создаем лист
-            if (str[node->end] != str[i]) {
-                Node* new_list = new Node(i, n);
-                node->next[str[i]] = new_list;
-                return;
-            }
-            // иначе переходим к следующему узлу
-            node = node->next[str[i]];
-        }
+void PrintLine(int n = 50) {
+    std::cout << "\n";
+    for (int i = 0; i < n; ++i) {
+        std::cout << "-";
     }
+    std::cout << "\n";
+}
 
-    // проверка за O(P) на то, что простой pattern содержится в строке
-    bool contains(const std::string& pattern) const {
-        if (pattern.empty()) {
-            return true;
-        }
-        if (!root->next.contains(pattern[0])) {
-            return false;
-        }
-        Node* node = root->next[pattern[0]];
-        int j = 0;
-        // идем по буквам в паттерне
-        for (int i = 0; i < static_cast<int>(pattern.size()); ++i, ++j) {
-            // узел закончился, переходим к следующему
-            if (node->begin + j == node->end) {
-                if (!node->next.contains(pattern[i])) {
-                    return false;
-                }
-                node = node->next[pattern[i]];
-                j = 0;
-            }
-            if (str[node->begin + j] != pattern[i]) {
-                return false;
+// время построения и память на вершину
+void BenchmarkConstruction() {
+    std::mt19937 gen(7);
+    for (int n : {2000, 8000, 32000}) {
+        std::vector<std::pair<std::string, std::string>> corpora = {
+                {"random", RandomString(gen, n, 4)},
+                {"fibonacci", FibonacciString(n)},
+        };
+        for (const auto&[name, str] : corpora) {
+            for (SuffixTree::Builder builder : {SuffixTree::Builder::Naive, SuffixTree::Builder::Ukkonen}) {
+                SuffixTree* tree = nullptr;
+                double build_time = MeasureSeconds([&] { tree = new SuffixTree(str, builder); });
+                size_t node_count = tree->NodeCount();
+                size_t node_bytes = tree->NodeBytes();
+                double free_time = MeasureSeconds([&] { delete tree; });
+                std::cout << (builder == SuffixTree::Builder::Naive ? "naive  " : "ukkonen") << " " << name
+                          << " N = " << n << ", " << node_count << " nodes:\tbuild " << build_time * 1000
+                          << " ms\tfree " << free_time * 1000 << " ms\t"
+                          << static_cast<double>(node_bytes) / node_count << " bytes/node\n";
             }
         }
-        // мы успешно прошли по дереву весь pattern => он есть в строке
-        return true;
     }
+}
 
-    void DeleteNode(Node* node) {
-        for (const auto&[c, next] : node->next) {
-            DeleteNode(next);
+// построение на произвольных байтах: у вершин до 256 детей
+void BenchmarkAlphabet() {
+    std::mt19937 gen(7);
+    for (int n : {1 << 20, 4 << 20}) {
+        std::vector<std::pair<std::string, std::string>> corpora = {
+                {"binary", RandomBytes(gen, n)},
+                {"utf-8 ", Utf8Text(gen, n)},
+        };
+        for (const auto&[name, str] : corpora) {
+            double build_time = MeasureSeconds([&] { SuffixTree tree(str); });
+            std::cout << name << " N = " << (n >> 20) << "M:\tbuild " << build_time * 1000 << " ms\t"
+                      << build_time * 1e9 / n << " ns/char\n";
         }
-        delete node;
     }
+}
 
-    void Print() const {
-        PrintNode(root);
+// время построения алгоритмом Укконена растет линейно: время на символ не зависит от N
+void BenchmarkScaling() {
+    std::mt19937 gen(7);
+    for (int alphabet_size : {4, 26}) {
+        for (int n = 1 << 20; n <= 8 << 20; n *= 2) {
+            std::string str = RandomString(gen, n, alphabet_size);
+            double build_time = MeasureSeconds([&] { SuffixTree tree(str); });
+            std::cout << "alphabet " << alphabet_size << ", N = " << (n >> 20) << "M:\tbuild " << build_time * 1000
+                      << " ms\t" << build_time * 1e9 / n << " ns/char\n";
+        }
     }
+}
 
-    void PrintNode(Node* node, int cnt = 0) const {
-        for (int i = 0; i < cnt - 1; ++i) {
-            std::cout << "    ";
+// поиск с k несовпадениями и k правками перебором по дереву против прохода по строке, k = 1..3
+void BenchmarkApproximate() {
+    std::mt19937 gen(5);
+    const int n = 1 << 20;
+    const int length = 16;
+    std::string str = RandomString(gen, n, 4);
+    SuffixTree tree(str);
+    auto naive_hamming = [&](const std::string& pattern, int k) {
+        size_t count = 0;
+        for (int start = 0; start + length <= n; ++start) {
+            int mismatches = 0;
+            for (int j = 0; j < length && mismatches <= k; ++j) {
+                mismatches += str[start + j] != pattern[j];
+            }
+            count += mismatches <= k;
         }
-        std::cout << "|";
-        std::cout << str.substr(node->begin, node->size()) << "\n";
-        for (const auto&[c, next] : node->next) {
-            PrintNode(next, cnt + 1);
+        return count;
+    };
+    // алгоритм Селлерса по перевернутым строкам: конец вхождения в перевернутой строке - начало в исходной
+    auto naive_edit = [&](const std::string& pattern, int k) {
+        std::string reversed(pattern.rbegin(), pattern.rend());
+        std::vector<int> column(length + 1);
+        for (int j = 0; j <= length; ++j) {
+            column[j] = j;
         }
+        size_t count = column[length] <= k;
+        for (int i = n - 1; i >= 0; --i) {
+            int diagonal = 0;
+            for (int j = 1; j <= length; ++j) {
+                int next = std::min({column[j] + 1, column[j - 1] + 1, diagonal + (reversed[j - 1] != str[i])});
+                diagonal = column[j];
+                column[j] = next;
+            }
+            count += column[length] <= k;
+        }
+        return count;
+    };
+    std::uniform_int_distribution<int> position(0, n - length);
+    std::uniform_int_distribution<int> letter(0, length - 1);
+    for (int k = 1; k <= 3; ++k) {
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 20; ++i) {
+            std::string pattern = str.substr(position(gen), length);
+            for (int j = 0; j < k; ++j) {
+                pattern[letter(gen)] = static_cast<char>('a' + gen() % 4);
+            }
+            patterns.push_back(pattern);
+        }
+        auto report = [&](const std::string& name, auto&& query) {
+            size_t found = 0;
+            double time = MeasureSeconds([&] {
+                for (const std::string& pattern : patterns) {
+                    found += query(pattern);
+                }
+            });
+            std::cout << "\t" << name << " " << time * 1e3 / patterns.size() << " ms (" << found << ")";
+        };
+        std::cout << "k = " << k << ":";
+        report("HammingSearch", [&](const std::string& pattern) { return tree.HammingSearch(pattern, k).size(); });
+        report("scan", [&](const std::string& pattern) { return naive_hamming(pattern, k); });
+        report("EditSearch", [&](const std::string& pattern) { return tree.EditSearch(pattern, k).size(); });
+        report("Sellers", [&](const std::string& pattern) { return naive_edit(pattern, k); });
+        std::cout << "\n";
     }
+}
 
-    ~SuffixTree() {
-        DeleteNode(root);
-    }
-};
-
-
-#include <cassert>
-
-void Check(const SuffixTree& tree, const std::string& str) {
-    for (int begin = 0; begin < static_cast<int>(str.size()); ++begin) {
-        for (int end = begin + 1; end <= static_cast<int>(str.size()); ++end) {
-            assert(tree.contains(str.substr(begin, end - begin)));
+// задержка запросов contains, Count и Locate на строке из 4M символов
+void BenchmarkQueries() {
+    std::mt19937 gen(9);
+    const int n = 4 << 20;
+    std::vector<std::pair<std::string, std::string>> corpora = {
+            {"random", RandomString(gen, n, 4)},
+            {"utf-8 ", Utf8Text(gen, n)},
+    };
+    for (const auto&[name, str] : corpora) {
+        SuffixTree tree(str);
+        std::uniform_int_distribution<int> length(4, 32);
+        std::uniform_int_distribution<int> position(0, n - 32);
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 100000; ++i) {
+            patterns.push_back(str.substr(position(gen), length(gen)));
         }
+        auto report = [&](const std::string& query_name, auto&& query) {
+            size_t found = 0;
+            double time = MeasureSeconds([&] {
+                for (const std::string& pattern : patterns) {
+                    found += query(pattern);
+                }
+            });
+            std::cout << "\t" << query_name << " " << time * 1e9 / patterns.size() << " ns (" << found << ")";
+        };
+        std::cout << name << ":";
+        report("contains", [&](const std::string& pattern) { return tree.contains(pattern); });
+        report("Count", [&](const std::string& pattern) { return tree.Count(pattern); });
+        report("Locate", [&](const std::string& pattern) { return tree.Locate(pattern).size(); });
+        std::cout << "\n";
     }
 }
 
-void PrintLine(int n = 50) {
-    std::cout << "\n";
-    for (int i = 0; i < n; ++i) {
-        std::cout << "-";
-    }
-    std::cout << "\n";
+// анализ повторов по дереву: все запросы линейны по длине строки
+void BenchmarkRepeats() {
+    std::mt19937 gen(10);
+    const int n = 1 << 20;
+    std::string str = Utf8Text(gen, n);
+    SuffixTree tree(str);
+    SuffixTree::Repeat longest{};
+    double longest_time = MeasureSeconds([&] { longest = tree.LongestRepeatedSubstring(); });
+    size_t maximal = 0;
+    double maximal_time = MeasureSeconds([&] { maximal = tree.MaximalRepeats(20).size(); });
+    int64_t distinct = 0;
+    double distinct_time = MeasureSeconds([&] { distinct = tree.DistinctSubstrings(); });
+    std::string other = Utf8Text(gen, n / 2);
+    SuffixTree::CommonSubstring common{};
+    double common_time = MeasureSeconds([&] { common = SuffixTree::LongestCommonSubstring(str, other); });
+    std::cout << "N = " << (n >> 20) << "M:\tlongest repeat " << longest.length << " (" << longest_time * 1000
+              << " ms)\tmaximal repeats >= 20: " << maximal << " (" << maximal_time * 1000 << " ms)\tdistinct "
+              << distinct << " (" << distinct_time * 1000 << " ms)\tLCS with 0.5M text " << common.length << " ("
+              << common_time * 1000 << " ms, with construction)\n";
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        BenchmarkConstruction();
+        BenchmarkScaling();
+        BenchmarkAlphabet();
+        BenchmarkApproximate();
+        BenchmarkQueries();
+        BenchmarkRepeats();
+        return 0;
+    }
+    {
+        // счетчики: в "banana" вставка суффиксов разрезает столько же ребер, сколько алгоритм Укконена
+        stats::Scope naive_scope;
+        SuffixTree naive("banana", SuffixTree::Builder::Naive);
+        uint64_t naive_splits = naive_scope.Delta()[stats::Counter::SuffixTreeSplits];
+        stats::Scope scope;
+        SuffixTree tree("banana");
+        bool found = tree.Count("ana") == 2;
+        stats::Snapshot delta = scope.Delta();
+        assert(found);
+        if constexpr (stats::ENABLED) {
+            assert(delta[stats::Counter::SuffixTreeSplits] == naive_splits && naive_splits > 0);
+            assert(delta[stats::Counter::SuffixTreeChildLookups] > 0 && delta.Calls(stats::Timer::SuffixTreeFind) == 1);
+        } else {
+            assert(naive_splits == 0 && delta.Calls(stats::Timer::SuffixTreeBuild) == 0);
+        }
+    }
     {
         // пример дерева
         std::string str = "xabxa";
@@ -169,6 +253,208 @@ int main() {
         Check(tree, str);
         assert(!tree.contains("anab"));
     }
+    {
+        // случайные строки над маленьким алфавитом: у вершин много детей,
+        // оба способа построения дают одно и то же дерево
+        std::mt19937 gen(1);
+        for (int t = 0; t < 100; ++t) {
+            std::string str = RandomString(gen, 30, 3);
+            SuffixTree naive_tree(str, SuffixTree::Builder::Naive);
+            SuffixTree tree(str, SuffixTree::Builder::Ukkonen);
+            std::ostringstream naive_out;
+            std::ostringstream out;
+            naive_tree.Print(naive_out);
+            tree.Print(out);
+            assert(naive_out.str() == out.str());
+            Check(tree, str);
+        }
+    }
+    {
+        // произвольные байты, в том числе '$' и '\0': терминальный символ не совпадает ни с одним байтом
+        std::mt19937 gen(2);
+        const std::string bytes = {'$', '\0', '\x7f', '\x80', '\xff'};
+        for (int t = 0; t < 100; ++t) {
+            std::uniform_int_distribution<int> byte(0, 1 + t % 4);
+            std::string str(t % 40, '\0');
+            for (char& c : str) {
+                c = bytes[byte(gen)];
+            }
+            SuffixTree naive_tree(str, SuffixTree::Builder::Naive);
+            SuffixTree tree(str, SuffixTree::Builder::Ukkonen);
+            std::ostringstream naive_out;
+            std::ostringstream out;
+            naive_tree.Print(naive_out);
+            tree.Print(out);
+            assert(naive_out.str() == out.str());
+            Check(tree, str);
+            assert(!tree.contains(str + '$') && !tree.contains("a"));
+        }
+        // большой алфавит: у вершин больше DENSE_DEGREE детей и есть плотные строки, а наивное построение
+        // потом разрезает ребра в такие вершины
+        std::vector<std::string> wide = {"ac"};
+        for (char c : std::string("0123456789ABCDEFGH")) {
+            wide[0].insert(wide[0].end() - 2, {'a', 'b', c});
+        }
+        for (int t = 0; t < 20; ++t) {
+            std::string str;
+            std::uniform_int_distribution<int> prefix(0, 3);
+            for (int i = 0; i < 60; ++i) {
+                str += std::string("abc").substr(0, prefix(gen)) + RandomBytes(gen, 1);
+            }
+            wide.push_back(str);
+        }
+        wide.push_back(RandomBytes(gen, 3000));
+        for (const std::string& str : wide) {
+            SuffixTree naive_tree(str, SuffixTree::Builder::Naive);
+            SuffixTree tree(str, SuffixTree::Builder::Ukkonen);
+            std::ostringstream naive_out;
+            std::ostringstream out;
+            naive_tree.Print(naive_out);
+            tree.Print(out);
+            assert(naive_out.str() == out.str());
+            for (size_t length = 1; length <= 3; ++length) {
+                for (size_t pos = 0; pos + length <= str.size(); ++pos) {
+                    // подстрока и она же с замененным первым символом, которой может не быть
+                    for (std::string pattern : {str.substr(pos, length), 'a' + str.substr(pos + 1, length - 1)}) {
+                        assert(naive_tree.contains(pattern) == tree.contains(pattern));
+                        assert(naive_tree.Count(pattern) == tree.Count(pattern));
+                        assert(naive_tree.Locate(pattern) == tree.Locate(pattern));
+                    }
+                }
+            }
+        }
+        assert(!SuffixTree(wide[0], SuffixTree::Builder::Naive).contains("a5"));
+        std::string utf8 = "ёжик и ёлка";
+        SuffixTree tree(utf8);
+        Check(tree, utf8);
+        assert(tree.contains("ёлк") && !tree.contains("ёжа"));
+    }
+
+    {
+        // поиск с k несовпадениями и k правками совпадает с проверкой каждой позиции
+        std::mt19937 gen(3);
+        for (int t = 0; t < 200; ++t) {
+            std::string str = RandomString(gen, t, 2 + t % 3);
+            SuffixTree tree(str, t % 2 == 0 ? SuffixTree::Builder::Ukkonen : SuffixTree::Builder::Naive);
+            for (int q = 0; q < 10; ++q) {
+                std::string pattern = RandomString(gen, q % 8, 2 + t % 3);
+                int k = q % 4;
+                std::vector<int> hamming;
+                std::vector<int> edit;
+                for (int start = 0; start <= static_cast<int>(str.size()); ++start) {
+                    if (start + pattern.size() <= str.size()) {
+                        int mismatches = 0;
+                        for (size_t j = 0; j < pattern.size(); ++j) {
+                            mismatches += pattern[j] != str[start + j];
+                        }
+                        if (mismatches <= k) {
+                            hamming.push_back(start);
+                        }
+                    }
+                    int width = str.size() - start;
+                    std::vector<std::vector<int>> table(pattern.size() + 1, std::vector<int>(width + 1));
+                    for (size_t i = 0; i <= pattern.size(); ++i) {
+                        for (int j = 0; j <= width; ++j) {
+                            if (i == 0 || j == 0) {
+                                table[i][j] = i + j;
+                            } else {
+                                table[i][j] = std::min({table[i - 1][j] + 1, table[i][j - 1] + 1,
+                                                        table[i - 1][j - 1] + (pattern[i - 1] != str[start + j - 1])});
+                            }
+                        }
+                    }
+                    if (*std::min_element(table.back().begin(), table.back().end()) <= k) {
+                        edit.push_back(start);
+                    }
+                }
+                assert(tree.HammingSearch(pattern, k) == hamming);
+                assert(tree.EditSearch(pattern, k) == edit);
+            }
+        }
+    }
+
+    {
+        // Count и Locate совпадают с поиском каждого вхождения, Locate перечисляет суффиксы по возрастанию
+        std::mt19937 gen(4);
+        for (int t = 0; t < 200; ++t) {
+            std::string str = RandomString(gen, t, 1 + t % 4);
+            SuffixTree tree(str, t % 2 == 0 ? SuffixTree::Builder::Ukkonen : SuffixTree::Builder::Naive);
+            for (int q = 0; q < 20; ++q) {
+                std::string pattern = RandomString(gen, q % 6, 1 + t % 4);
+                std::vector<int> expected;
+                for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1)) {
+                    expected.push_back(pos);
+                }
+                std::vector<int> found = tree.Locate(pattern);
+                for (size_t i = 1; i < found.size(); ++i) {
+                    assert(str.substr(found[i - 1]) < str.substr(found[i]));
+                }
+                std::sort(found.begin(), found.end());
+                assert(found == expected);
+                assert(tree.Count(pattern) == static_cast<int>(expected.size()));
+            }
+        }
+    }
+
+    {
+        // анализ повторов совпадает с перебором всех подстрок
+        std::mt19937 gen(8);
+        for (int t = 0; t < 200; ++t) {
+            std::string str = t % 7 == 0 ? FibonacciString(t) : RandomString(gen, t, 1 + t % 4);
+            SuffixTree tree(str, t % 2 == 0 ? SuffixTree::Builder::Ukkonen : SuffixTree::Builder::Naive);
+            std::map<std::string, std::vector<int>> occurrences;
+            for (size_t begin = 0; begin < str.size(); ++begin) {
+                for (size_t length = 1; begin + length <= str.size(); ++length) {
+                    occurrences[str.substr(begin, length)].push_back(begin);
+                }
+            }
+            assert(tree.DistinctSubstrings() == static_cast<int64_t>(occurrences.size()));
+            int longest = 0;
+            int min_length = 1 + t % 3;
+            std::vector<SuffixTree::Repeat> expected;
+            for (const auto&[substring, positions] : occurrences) {
+                int length = substring.size();
+                if (positions.size() < 2) {
+                    continue;
+                }
+                longest = std::max(longest, length);
+                // символы до и после вхождений, -1 - начало или конец строки
+                std::set<int> before;
+                std::set<int> after;
+                for (int pos : positions) {
+                    before.insert(pos == 0 ? -1 : str[pos - 1]);
+                    after.insert(pos + length == static_cast<int>(str.size()) ? -1 : str[pos + length]);
+                }
+                bool left_maximal = before.size() > 1 || before.count(-1);
+                bool right_maximal = after.size() > 1 || after.count(-1);
+                if (left_maximal && right_maximal && length >= min_length) {
+                    expected.push_back({positions[0], length, static_cast<int>(positions.size())});
+                }
+            }
+            std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+                return a.position != b.position ? a.position < b.position : a.length < b.length;
+            });
+            assert(tree.MaximalRepeats(min_length) == expected);
+            SuffixTree::Repeat repeat = tree.LongestRepeatedSubstring();
+            assert(repeat.length == longest);
+            if (longest > 0) {
+                const std::vector<int>& positions = occurrences[str.substr(repeat.position, repeat.length)];
+                assert(positions[0] == repeat.position && static_cast<int>(positions.size()) == repeat.count);
+            }
+            std::string other = RandomString(gen, t % 13, 1 + t % 4);
+            int common = 0;
+            for (size_t begin = 0; begin < other.size(); ++begin) {
+                for (size_t length = 1; begin + length <= other.size(); ++length) {
+                    if (occurrences.count(other.substr(begin, length))) {
+                        common = std::max(common, static_cast<int>(length));
+                    }
+                }
+            }
+            SuffixTree::CommonSubstring lcs = SuffixTree::LongestCommonSubstring(str, other);
+            assert(lcs.length == common);
+            assert(str.substr(lcs.first_position, lcs.length) == other.substr(lcs.second_position, lcs.length));
+        }
+    }
 
     return 0;
 }
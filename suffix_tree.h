@@ -0,0 +1,642 @@
+#pragma once
+
+#include "stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class SuffixTree {
+public:
+    enum class Builder {
+        // вставка суффиксов по одному от корня, O(N^2)
+        Naive,
+        // алгоритм Укконена с суффиксными ссылками и активной точкой, O(N)
+        Ukkonen,
+    };
+
+private:
+    // корень не бывает ребенком, поэтому 0 означает "нет вершины"
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t NONE = 0;
+    // терминальный символ в конце строки: меньше любого байта и не совпадает ни с одним из них
+    static constexpr int TERMINATOR = 0;
+    // байт, которого нет в строке
+    static constexpr int ABSENT = -1;
+    // с этого числа детей список дополняется плотной строкой (но не раньше, чем строка заполнится на 1/8)
+    static constexpr int DENSE_DEGREE = 16;
+
+    // вершины дерева лежат в одном массиве и ссылаются друг на друга 32-битными индексами,
+    // дети вершины - односвязный список, упорядоченный по первому символу ребра
+    struct Node {
+        int begin;
+        int end;
+        uint32_t first_child;
+        uint32_t next_sibling;
+        // суффиксная ссылка, нужна только при построении алгоритмом Укконена
+        uint32_t suffix_link;
+        // у вершины с большим числом детей есть еще и плотная строка детей по символам, см. dense_children
+        uint32_t dense_row;
+        // листья поддерева - отрезок [leaf_begin, leaf_end) массива leaf_starts, заполняется после построения
+        uint32_t leaf_begin;
+        uint32_t leaf_end;
+
+        Node(int start, int end, uint32_t first_child, uint32_t next_sibling)
+                : begin(start), end(end), first_child(first_child), next_sibling(next_sibling), suffix_link(0),
+                  dense_row(0), leaf_begin(0), leaf_end(0) {}
+
+        int size() const {
+            return end - begin;
+        }
+    };
+
+    std::vector<Node> nodes;
+    // строка и '$' в конце; '$' нужен только для печати, сравнивается TERMINATOR
+    std::string str;
+    int n;
+    // алфавит сжат до байтов строки: symbols[byte] - 1..alphabet_size - 1 в порядке байтов или ABSENT
+    std::array<int, 256> symbols;
+    int alphabet_size;
+    // плотные строки детей: dense_children[row * alphabet_size + c] - ребенок по символу c, строка 0 не используется
+    std::vector<uint32_t> dense_children;
+    // начала суффиксов в порядке обхода дерева, то есть в лексикографическом порядке
+    std::vector<int> leaf_starts;
+    // после построения дети вершины node лежат подряд: child_nodes[child_begin[node]..child_begin[node + 1]),
+    // child_symbols - первые символы их ребер по возрастанию; запросы не ходят по спискам next_sibling
+    std::vector<uint32_t> child_begin;
+    std::vector<uint32_t> child_nodes;
+    std::vector<uint16_t> child_symbols;
+
+    // символ строки: номер байта в сжатом алфавите или TERMINATOR
+    int Symbol(int pos) const {
+        return pos == n - 1 ? TERMINATOR : symbols[static_cast<unsigned char>(str[pos])];
+    }
+
+    void MakeAlphabet() {
+        symbols.fill(ABSENT);
+        for (int i = 0; i < n - 1; ++i) {
+            symbols[static_cast<unsigned char>(str[i])] = 0;
+        }
+        alphabet_size = 1;
+        for (int& symbol : symbols) {
+            if (symbol != ABSENT) {
+                symbol = alphabet_size++;
+            }
+        }
+        dense_children.assign(alphabet_size, NONE);
+    }
+
+    uint32_t NewNode(int begin, int end) {
+        nodes.emplace_back(begin, end, NONE, NONE);
+        return nodes.size() - 1;
+    }
+
+    // ребенок node, ребро в который начинается с символа c
+    uint32_t Child(uint32_t node, int c) const {
+        if (nodes[node].dense_row != 0) {
+            return dense_children[nodes[node].dense_row * alphabet_size + c];
+        }
+        for (uint32_t child = nodes[node].first_child; child != NONE; child = nodes[child].next_sibling) {
+            if (Symbol(nodes[child].begin) == c) {
+                return child;
+            }
+        }
+        return NONE;
+    }
+
+    void AddChild(uint32_t node, uint32_t child) {
+        int c = Symbol(nodes[child].begin);
+        uint32_t* link = &nodes[node].first_child;
+        int degree = 1;
+        while (*link != NONE && Symbol(nodes[*link].begin) < c) {
+            link = &nodes[*link].next_sibling;
+            ++degree;
+        }
+        nodes[child].next_sibling = *link;
+        *link = child;
+        if (nodes[node].dense_row != 0) {
+            dense_children[nodes[node].dense_row * alphabet_size + c] = child;
+            return;
+        }
+        for (uint32_t next = nodes[child].next_sibling; next != NONE; next = nodes[next].next_sibling) {
+            ++degree;
+        }
+        // поиск по списку из сотен детей (большой алфавит) медленный: переходим к плотной строке
+        if (degree >= DENSE_DEGREE && 8 * degree >= alphabet_size) {
+            nodes[node].dense_row = dense_children.size() / alphabet_size;
+            dense_children.resize(dense_children.size() + alphabet_size, NONE);
+            for (uint32_t next = nodes[node].first_child; next != NONE; next = nodes[next].next_sibling) {
+                dense_children[nodes[node].dense_row * alphabet_size + Symbol(nodes[next].begin)] = next;
+            }
+        }
+    }
+
+    // ребенок node по символу c в раскладке для запросов: плотная строка или короткий отрезок child_symbols
+    uint32_t QueryChild(uint32_t node, int c) const {
+        if (nodes[node].dense_row != 0) {
+            return dense_children[nodes[node].dense_row * alphabet_size + c];
+        }
+        for (uint32_t i = child_begin[node]; i < child_begin[node + 1]; ++i) {
+            if (child_symbols[i] >= c) {
+                return child_symbols[i] == c ? child_nodes[i] : NONE;
+            }
+        }
+        return NONE;
+    }
+
+    // после построения: дети каждой вершины подряд в child_nodes и отрезки листьев вершин
+    void Annotate() {
+        child_begin.assign(nodes.size() + 1, 0);
+        // каждая вершина, кроме корня, - ребенок ровно одной вершины
+        child_nodes.reserve(nodes.size() - 1);
+        child_symbols.reserve(nodes.size() - 1);
+        for (uint32_t node = 0; node < nodes.size(); ++node) {
+            child_begin[node + 1] = child_begin[node];
+            for (uint32_t child = nodes[node].first_child; child != NONE; child = nodes[child].next_sibling) {
+                child_nodes.push_back(child);
+                child_symbols.push_back(Symbol(nodes[child].begin));
+                ++child_begin[node + 1];
+            }
+        }
+        // обход в глубину без рекурсии: вершина кладется в стек дважды, второй раз - чтобы закрыть ее отрезок
+        leaf_starts.reserve(n);
+        std::vector<std::tuple<uint32_t, int, bool>> stack = {{ROOT, 0, false}};
+        while (!stack.empty()) {
+            auto[node, depth, closing] = stack.back();
+            stack.pop_back();
+            if (closing) {
+                nodes[node].leaf_end = leaf_starts.size();
+                continue;
+            }
+            nodes[node].leaf_begin = leaf_starts.size();
+            if (child_begin[node] == child_begin[node + 1]) {
+                // лист, до конца ребра которого depth символов, - суффикс n - depth
+                leaf_starts.push_back(n - depth);
+                nodes[node].leaf_end = leaf_starts.size();
+                continue;
+            }
+            stack.emplace_back(node, depth, true);
+            for (uint32_t i = child_begin[node + 1]; i-- > child_begin[node];) {
+                stack.emplace_back(child_nodes[i], depth + nodes[child_nodes[i]].size(), false);
+            }
+        }
+    }
+
+    // вершина, на ребре в которую заканчивается непустой pattern, или NONE, если pattern нет в строке
+    // (пустой pattern заканчивается в корне, а ROOT == NONE, поэтому его разбирают вызывающие)
+    uint32_t Find(const std::string& pattern) const {
+        stats::ScopedTimer timer(stats::Timer::SuffixTreeFind);
+        uint32_t node = ROOT;
+        int j = 0;
+        // идем по буквам в паттерне
+        for (char c : pattern) {
+            int symbol = symbols[static_cast<unsigned char>(c)];
+            if (symbol == ABSENT) {
+                return NONE;
+            }
+            // узел закончился, переходим к следующему
+            if (nodes[node].begin + j == nodes[node].end) {
+                stats::Add(stats::Counter::SuffixTreeChildLookups);
+                node = QueryChild(node, symbol);
+                if (node == NONE) {
+                    return NONE;
+                }
+                j = 0;
+            }
+            if (Symbol(nodes[node].begin + j) != symbol) {
+                return NONE;
+            }
+            ++j;
+        }
+        return node;
+    }
+
+    // ставит new_child на место old_child, у них одинаковая первая буква ребра
+    void ReplaceChild(uint32_t node, uint32_t old_child, uint32_t new_child) {
+        if (nodes[node].dense_row != 0) {
+            dense_children[nodes[node].dense_row * alphabet_size + Symbol(nodes[old_child].begin)] = new_child;
+        }
+        uint32_t* link = &nodes[node].first_child;
+        while (*link != old_child) {
+            link = &nodes[*link].next_sibling;
+        }
+        nodes[new_child].next_sibling = nodes[old_child].next_sibling;
+        nodes[old_child].next_sibling = NONE;
+        *link = new_child;
+    }
+
+    // построение за O(N): на шаге pos дерево содержит все суффиксы str[0..pos],
+    // remainder суффиксов, которые еще не стали листьями, начинаются в активной точке
+    void BuildUkkonen() {
+        uint32_t active_node = ROOT;
+        int active_edge = 0;
+        int active_length = 0;
+        int remainder = 0;
+        for (int pos = 0; pos < n; ++pos) {
+            uint32_t last_new_node = NONE;
+            ++remainder;
+            while (remainder > 0) {
+                if (active_length == 0) {
+                    active_edge = pos;
+                }
+                uint32_t next = Child(active_node, Symbol(active_edge));
+                if (next == NONE) {
+                    // из активной вершины нет ребра по нужной букве: новый лист
+                    AddChild(active_node, NewNode(pos, n));
+                    if (last_new_node != NONE) {
+                        nodes[last_new_node].suffix_link = active_node;
+                        last_new_node = NONE;
+                    }
+                } else {
+                    // листья растут вместе с pos, поэтому их длина ограничена текущей позицией
+                    int edge_length = std::min(nodes[next].end, pos + 1) - nodes[next].begin;
+                    if (active_length >= edge_length) {
+                        // активная точка за концом ребра, спускаемся
+                        active_edge += edge_length;
+                        active_length -= edge_length;
+                        active_node = next;
+                        continue;
+                    }
+                    if (Symbol(nodes[next].begin + active_length) == Symbol(pos)) {
+                        // суффикс уже есть в дереве, он и все более короткие продлятся на следующих шагах
+                        if (last_new_node != NONE) {
+                            nodes[last_new_node].suffix_link = active_node;
+                        }
+                        ++active_length;
+                        break;
+                    }
+                    // разрезаем ребро: новая внутренняя вершина и новый лист
+                    stats::Add(stats::Counter::SuffixTreeSplits);
+                    uint32_t split = NewNode(nodes[next].begin, nodes[next].begin + active_length);
+                    ReplaceChild(active_node, next, split);
+                    nodes[next].begin += active_length;
+                    AddChild(split, next);
+                    AddChild(split, NewNode(pos, n));
+                    if (last_new_node != NONE) {
+                        nodes[last_new_node].suffix_link = split;
+                    }
+                    last_new_node = split;
+                }
+                --remainder;
+                // переходим к следующему по длине суффиксу
+                if (active_node == ROOT && active_length > 0) {
+                    --active_length;
+                    active_edge = pos - remainder + 1;
+                } else if (active_node != ROOT) {
+                    active_node = nodes[active_node].suffix_link;
+                }
+            }
+        }
+    }
+
+    // байты pattern в сжатом алфавите; байт, которого нет в строке, - ABSENT и не совпадает ни с одним символом
+    std::vector<int> PatternSymbols(const std::string& pattern) const {
+        std::vector<int> pattern_symbols(pattern.size());
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            pattern_symbols[i] = symbols[static_cast<unsigned char>(pattern[i])];
+        }
+        return pattern_symbols;
+    }
+
+    // обход в порядке "дети раньше родителя": visit(node, depth), depth - число символов до конца ребра node
+    template <class F>
+    void PostOrder(F&& visit) const {
+        std::vector<std::tuple<uint32_t, int, bool>> stack = {{ROOT, 0, false}};
+        while (!stack.empty()) {
+            auto[node, depth, closing] = stack.back();
+            stack.pop_back();
+            if (closing) {
+                visit(node, depth);
+                continue;
+            }
+            stack.emplace_back(node, depth, true);
+            for (uint32_t i = child_begin[node]; i < child_begin[node + 1]; ++i) {
+                stack.emplace_back(child_nodes[i], depth + nodes[child_nodes[i]].size(), false);
+            }
+        }
+    }
+
+    void AddLeaves(uint32_t node, std::vector<int>& ans) const {
+        ans.insert(ans.end(), leaf_starts.begin() + nodes[node].leaf_begin, leaf_starts.begin() + nodes[node].leaf_end);
+    }
+
+    // спуск по ребру node, над которым depth символов, из них matched сравнены с pattern с mismatches несовпадениями
+    void HammingWalk(uint32_t node, int depth, int matched, int mismatches, const std::vector<int>& pattern_symbols,
+                     int k, std::vector<int>& ans) const {
+        int length = pattern_symbols.size();
+        for (int pos = nodes[node].begin; pos < nodes[node].end && matched < length; ++pos, ++matched) {
+            int symbol = Symbol(pos);
+            // вхождение не может выходить за конец строки
+            if (symbol == TERMINATOR) {
+                return;
+            }
+            mismatches += symbol != pattern_symbols[matched];
+            if (mismatches > k) {
+                return;
+            }
+        }
+        depth += nodes[node].size();
+        if (matched == length) {
+            AddLeaves(node, ans);
+            return;
+        }
+        for (uint32_t i = child_begin[node]; i < child_begin[node + 1]; ++i) {
+            HammingWalk(child_nodes[i], depth, matched, mismatches, pattern_symbols, k, ans);
+        }
+    }
+
+    // columns[d][i] - расстояние редактирования между pattern[0..i) и первыми d символами пути от корня
+    void EditWalk(uint32_t node, int depth, const std::vector<int>& pattern_symbols, int k,
+                  std::vector<std::vector<int>>& columns, std::vector<int>& ans) const {
+        int length = pattern_symbols.size();
+        int edge_depth = depth + nodes[node].size();
+        for (int pos = nodes[node].begin; pos < nodes[node].end; ++pos) {
+            int symbol = Symbol(pos);
+            if (symbol == TERMINATOR) {
+                return;
+            }
+            int d = depth + (pos - nodes[node].begin) + 1;
+            if (d == static_cast<int>(columns.size())) {
+                columns.emplace_back(length + 1);
+            }
+            const std::vector<int>& previous = columns[d - 1];
+            std::vector<int>& current = columns[d];
+            current[0] = d;
+            int column_min = d;
+            for (int i = 1; i <= length; ++i) {
+                current[i] = std::min({previous[i] + 1, current[i - 1] + 1,
+                                       previous[i - 1] + (symbol != pattern_symbols[i - 1])});
+                column_min = std::min(column_min, current[i]);
+            }
+            if (current[length] <= k) {
+                AddLeaves(node, ans);
+                return;
+            }
+            if (column_min > k) {
+                return;
+            }
+        }
+        for (uint32_t i = child_begin[node]; i < child_begin[node + 1]; ++i) {
+            EditWalk(child_nodes[i], edge_depth, pattern_symbols, k, columns, ans);
+        }
+    }
+
+public:
+    // построение суффиксного дерева за O(N) алгоритмом Укконена или за O(N^2) вставкой суффиксов
+    explicit SuffixTree(const std::string& input_str, Builder builder = Builder::Ukkonen)
+            : str(input_str + '$'), n(str.size()) {
+        stats::ScopedTimer timer(stats::Timer::SuffixTreeBuild);
+        MakeAlphabet();
+        // у дерева не больше 2N вершин, поэтому массив не переезжает во время построения
+        nodes.reserve(2 * n + 1);
+        NewNode(0, 0);
+        if (builder == Builder::Ukkonen) {
+            BuildUkkonen();
+        } else {
+            // последовательно вставляем все суффиксы
+            for (int i = 0; i < static_cast<int>(str.size()); ++i) {
+                insert(i);
+            }
+        }
+        Annotate();
+    }
+
+    void insert(int suffix_begin) {
+        // если от корня нет такой буквы, то вставляем новый лист
+        uint32_t node = Child(ROOT, Symbol(suffix_begin));
+        if (node == NONE) {
+            AddChild(ROOT, NewNode(suffix_begin, n));
+            return;
+        }
+        // идем по новому суффиксу
+        for (int i = suffix_begin; i < n;) {
+            // идем по буквам в текущем узле
+            for (int j = 0; j < nodes[node].size(); ++j) {
+                // если есть несовпадение, делаем ответвление
+                if (Symbol(nodes[node].begin + j) != Symbol(i + j)) {
+                    stats::Add(stats::Counter::SuffixTreeSplits);
+                    // новый лист
+                    uint32_t new_list = NewNode(i + j, n);
+                    // новая внутренняя вершина
+                    uint32_t new_node = NewNode(nodes[node].begin + j, nodes[node].end);
+                    nodes[node].end = nodes[node].begin + j;
+                    // дети и их плотная строка переходят к new_node, у node остаются только два новых ребенка
+                    nodes[new_node].first_child = nodes[node].first_child;
+                    nodes[new_node].dense_row = nodes[node].dense_row;
+                    nodes[node].first_child = NONE;
+                    nodes[node].dense_row = 0;
+                    AddChild(node, new_node);
+                    AddChild(node, new_list);
+                    return;
+                }
+            }
+            i += nodes[node].size();
+            // если в следующях узлах нет такой буквы, создаем лист
+            uint32_t next = Child(node, Symbol(i));
+            if (next == NONE) {
+                AddChild(node, NewNode(i, n));
+                return;
+            }
+            // иначе переходим к следующему узлу
+            node = next;
+        }
+    }
+
+    // проверка за O(P) на то, что простой pattern содержится в строке
+    bool contains(const std::string& pattern) const {
+        return pattern.empty() || Find(pattern) != NONE;
+    }
+
+    // число вхождений pattern за O(P): число листьев под вершиной, где заканчивается pattern
+    int Count(const std::string& pattern) const {
+        if (pattern.empty()) {
+            return n;
+        }
+        uint32_t node = Find(pattern);
+        return node == NONE ? 0 : nodes[node].leaf_end - nodes[node].leaf_begin;
+    }
+
+    // позиции вхождений pattern в лексикографическом порядке суффиксов за O(P + число вхождений)
+    std::vector<int> Locate(const std::string& pattern) const {
+        std::vector<int> ans;
+        uint32_t node = Find(pattern);
+        if (pattern.empty() || node != NONE) {
+            AddLeaves(node, ans);
+        }
+        return ans;
+    }
+
+    // позиции (по возрастанию), с которых pattern совпадает со строкой во всех символах, кроме не более чем k.
+    // Перебор с возвратом по дереву: путь отбрасывается на (k + 1)-м несовпадении, поэтому число посещенных
+    // символов зависит от длины pattern и k, а не от длины строки
+    std::vector<int> HammingSearch(const std::string& pattern, int k) const {
+        std::vector<int> pattern_symbols = PatternSymbols(pattern);
+        std::vector<int> ans;
+        if (pattern.empty()) {
+            AddLeaves(ROOT, ans);
+        } else {
+            for (uint32_t i = child_begin[ROOT]; i < child_begin[ROOT + 1]; ++i) {
+                HammingWalk(child_nodes[i], 0, 0, 0, pattern_symbols, k, ans);
+            }
+        }
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+
+    // позиции (по возрастанию), с которых начинается подстрока на расстоянии редактирования не больше k от pattern.
+    // Обход дерева со столбцом таблицы редактирования на каждый символ пути: путь отбрасывается, когда весь столбец
+    // больше k, а как только pattern целиком укладывается в k правок, подходят все листья поддерева
+    std::vector<int> EditSearch(const std::string& pattern, int k) const {
+        std::vector<int> pattern_symbols = PatternSymbols(pattern);
+        std::vector<std::vector<int>> columns(1, std::vector<int>(pattern.size() + 1));
+        for (size_t i = 0; i <= pattern.size(); ++i) {
+            columns[0][i] = i;
+        }
+        std::vector<int> ans;
+        if (static_cast<int>(pattern.size()) <= k) {
+            AddLeaves(ROOT, ans);
+        } else {
+            for (uint32_t i = child_begin[ROOT]; i < child_begin[ROOT + 1]; ++i) {
+                EditWalk(child_nodes[i], 0, pattern_symbols, k, columns, ans);
+            }
+        }
+        std::sort(ans.begin(), ans.end());
+        return ans;
+    }
+
+    // повтор: подстрока str[position..position + length), которая встречается count раз
+    struct Repeat {
+        int position;
+        int length;
+        int count;
+
+        bool operator==(const Repeat&) const = default;
+    };
+
+    // общая подстрока двух строк: first[first_position..] и second[second_position..] совпадают на length символах
+    struct CommonSubstring {
+        int first_position;
+        int second_position;
+        int length;
+    };
+
+    // самая длинная подстрока, которая встречается хотя бы дважды (первое вхождение): самая глубокая
+    // внутренняя вершина
+    Repeat LongestRepeatedSubstring() const {
+        uint32_t deepest = ROOT;
+        int deepest_depth = 0;
+        PostOrder([&](uint32_t node, int depth) {
+            if (node != ROOT && child_begin[node] != child_begin[node + 1] && depth > deepest_depth) {
+                deepest = node;
+                deepest_depth = depth;
+            }
+        });
+        if (deepest == ROOT) {
+            return {0, 0, 0};
+        }
+        const Node& node = nodes[deepest];
+        return {*std::min_element(leaf_starts.begin() + node.leaf_begin, leaf_starts.begin() + node.leaf_end),
+                deepest_depth, static_cast<int>(node.leaf_end - node.leaf_begin)};
+    }
+
+    // максимальные повторы длины не меньше min_length, по возрастанию (position, length); position - первое
+    // вхождение. Максимальный вправо повтор - внутренняя вершина, максимальный влево - вершина, у листьев которой
+    // разные символы перед суффиксом; эти символы и первые вхождения собираются снизу вверх за O(N)
+    std::vector<Repeat> MaximalRepeats(int min_length = 1) const {
+        const int NO_SYMBOL = -1;
+        const int DIVERSE = -2;
+        std::vector<int> symbol(nodes.size(), NO_SYMBOL);
+        std::vector<int> first(nodes.size(), n);
+        std::vector<Repeat> ans;
+        PostOrder([&](uint32_t node, int depth) {
+            if (child_begin[node] == child_begin[node + 1]) {
+                int start = n - depth;
+                symbol[node] = start == 0 ? DIVERSE : static_cast<unsigned char>(str[start - 1]);
+                first[node] = start;
+                return;
+            }
+            for (uint32_t i = child_begin[node]; i < child_begin[node + 1]; ++i) {
+                int child_symbol = symbol[child_nodes[i]];
+                symbol[node] = symbol[node] == NO_SYMBOL || symbol[node] == child_symbol ? child_symbol : DIVERSE;
+                first[node] = std::min(first[node], first[child_nodes[i]]);
+            }
+            if (node != ROOT && depth >= min_length && symbol[node] == DIVERSE) {
+                ans.push_back({first[node], depth, static_cast<int>(nodes[node].leaf_end - nodes[node].leaf_begin)});
+            }
+        });
+        std::sort(ans.begin(), ans.end(), [](const Repeat& a, const Repeat& b) {
+            return a.position != b.position ? a.position < b.position : a.length < b.length;
+        });
+        return ans;
+    }
+
+    // число различных непустых подстрок: сумма длин ребер без терминального символа
+    int64_t DistinctSubstrings() const {
+        int64_t ans = 0;
+        for (uint32_t node = 1; node < nodes.size(); ++node) {
+            ans += nodes[node].size() - (nodes[node].end == n ? 1 : 0);
+        }
+        return ans;
+    }
+
+    // самая длинная общая подстрока first и second по дереву first + second без разделителя: во внутренней
+    // вершине, под которой есть суффиксы обеих строк, общая длина ограничена глубиной и концом first
+    // для самого левого суффикса first
+    static CommonSubstring LongestCommonSubstring(const std::string& first, const std::string& second) {
+        SuffixTree tree(first + second);
+        int first_size = first.size();
+        std::vector<int> first_start(tree.nodes.size(), first_size);
+        std::vector<int> second_start(tree.nodes.size(), -1);
+        CommonSubstring ans{0, 0, 0};
+        tree.PostOrder([&](uint32_t node, int depth) {
+            if (tree.child_begin[node] == tree.child_begin[node + 1]) {
+                int start = tree.n - depth;
+                // лист из одного терминального символа не общий ни с чем
+                if (start < first_size) {
+                    first_start[node] = start;
+                } else if (start < tree.n - 1) {
+                    second_start[node] = start;
+                }
+                return;
+            }
+            for (uint32_t i = tree.child_begin[node]; i < tree.child_begin[node + 1]; ++i) {
+                first_start[node] = std::min(first_start[node], first_start[tree.child_nodes[i]]);
+                second_start[node] = std::max(second_start[node], second_start[tree.child_nodes[i]]);
+            }
+            int length = std::min(depth, first_size - first_start[node]);
+            if (node != ROOT && second_start[node] != -1 && length > ans.length) {
+                ans = {first_start[node], second_start[node] - first_size, length};
+            }
+        });
+        return ans;
+    }
+
+    size_t NodeCount() const {
+        return nodes.size();
+    }
+
+    size_t NodeBytes() const {
+        return nodes.capacity() * sizeof(Node) + dense_children.capacity() * sizeof(uint32_t) +
+               leaf_starts.capacity() * sizeof(int) + (child_begin.capacity() + child_nodes.capacity()) * sizeof(uint32_t) +
+               child_symbols.capacity() * sizeof(uint16_t);
+    }
+
+    void Print(std::ostream& out = std::cout) const {
+        PrintNode(out, ROOT);
+    }
+
+    void PrintNode(std::ostream& out, uint32_t node, int cnt = 0) const {
+        for (int i = 0; i < cnt - 1; ++i) {
+            out << "    ";
+        }
+        out << "|";
+        out << str.substr(nodes[node].begin, nodes[node].size()) << "\n";
+        for (uint32_t child = nodes[node].first_child; child != NONE; child = nodes[child].next_sibling) {
+            PrintNode(out, child, cnt + 1);
+        }
+    }
+};